@@ -5,6 +5,135 @@
 # the results are stored in the ../results/ folder 
 ######################################################################################
 
+########## ---------------  Native traces ---------------- ################
+
+# Optional: decompress the gzip traces once into the native format. sim
+# detects it from the file header and mmap()s it, so the runs below can
+# use ../traces/*.mtrb in place of ../traces/*.mtr.gz
+
+# for t in bzip2 lbm libq; do ../src/trace_convert ../traces/$t.mtr.gz ../traces/$t.mtrb; done
+
+# The columnar format is smaller and seekable: -trace_skip/-trace_max then
+# jump straight to the requested instruction for sampled or chunked runs
+
+# for t in bzip2 lbm libq; do ../src/trace_convert -columnar ../traces/$t.mtr.gz ../traces/$t.mtrc; done
+
+########## ---------------  Sweeps ---------------- ################
+
+# Optional: run many configurations over the same traces in one process.
+# Each trace is decoded once and shared; every line of the sweep file is
+# "<output file> [-option <value>] ..." on top of the command line, e.g.
+#
+#   ../results/E.Q1.mix1.res -L2repl 1 -SWP_core0ways 4
+#   ../results/E.Q2.mix1.res -L2repl 1 -SWP_core0ways 8
+#
+# ../src/sim -mode 4 -sweep E.mix1.sweep ../traces/bzip2.mtr.gz ../traces/libq.mtr.gz
+
+########## ---------------  Batch jobs ---------------- ################
+
+# Optional: runall.jobs lists the D/E/F runs below, one simulation per
+# line. sim runs them on a pool of worker threads and writes the same
+# ../results/*.res files, so the GenReport section still applies
+
+# ../src/sim -jobs runall.jobs
+
+########## ---------------  Miss-ratio curves ---------------- ################
+
+# Optional: one run with -sdprof gives LRU miss ratios for every cache size
+# from 64KB to 64MB (and every associativity up to 32 in the csv) instead of
+# one run per -L2sizeKB
+
+# ../src/sim -mode 3 -sdprof 32 -sdprof_csv ../results/C.bzip2.mrc.csv ../traces/bzip2.mtr.gz > ../results/C.bzip2.mrc.res
+
+########## ---------------  Interval stats ---------------- ################
+
+# Optional: a time series of per-core IPC, miss rates, delays and DRAM row
+# hits every 1M cycles shows phases that the end-of-run totals average out
+
+# ../src/sim -mode 4 -L2repl 1 -SWP_core0ways 8 -interval_cycles 1000000 -interval_out ../results/E.Q2.mix1.csv ../traces/bzip2.mtr.gz ../traces/libq.mtr.gz > ../results/E.Q2.mix1.res
+
+########## ---------------  Replacement policies ---------------- ################
+
+# Optional: the L2 policy by number or name (fifo, lru, plru, rnd, srrip,
+# brrip, drrip; -repl sets the L1s). A sweep compares them in one pass:
+#
+#   ../results/C.bzip2.fifo.res  -L2repl fifo
+#   ../results/C.bzip2.lru.res   -L2repl lru
+#   ../results/C.bzip2.drrip.res -L2repl drrip
+#
+# ../src/sim -mode 3 -sweep C.repl.sweep ../traces/bzip2.mtr.gz
+#
+# UCP (-L2repl 4) repartitions the L2 ways between the cores every
+# -UCP_epoch cycles and lists every decision in the stats:
+#
+# ../src/sim -mode 4 -L2repl 4 -UCP_epoch 5000000 ../traces/bzip2.mtr.gz ../traces/libq.mtr.gz > ../results/G.ucp.mix1.res
+
+########## ---------------  Prefetchers ---------------- ################
+
+# Optional: prefetch into the L1 dcache and/or the L2 (next, stride, stream),
+# with the useful/late/useless counts and extra DRAM traffic in the stats
+
+# ../src/sim -mode 3 -Dprefetch stride -L2prefetch stream -L2prefetch_degree 4 ../traces/lbm.mtr.gz > ../results/C.lbm.prefetch.res
+
+########## ---------------  Cache hierarchies ---------------- ################
+
+# Optional: -hier builds the caches from a file instead of the -D/-L2
+# options, one level per line (see src/hier.h). l3.hier has per-core L1s
+# and L2s and a shared L3:
+
+# ../src/sim -mode 4 -hier l3.hier ../traces/bzip2.mtr.gz ../traces/libq.mtr.gz > ../results/H.l3.mix1.res
+
+# An inclusive L2 back-invalidates the L1s of every core when it evicts a
+# line, an exclusive one holds only L1 victims (-L2inclusion, or -inclusion
+# in a -hier file). The stats count the back-invalidations and the
+# effective capacity of the L2 together with the L1s:
+
+# ../src/sim -mode 4 -L2inclusion inclusive ../traces/bzip2.mtr.gz ../traces/libq.mtr.gz > ../results/H.incl.mix1.res
+# ../src/sim -mode 4 -L2inclusion exclusive ../traces/bzip2.mtr.gz ../traces/libq.mtr.gz > ../results/H.excl.mix1.res
+
+# A small victim cache behind the L1 DCACHE catches its conflict misses
+# (-Dvictim, or -victim in a -hier file for any level):
+
+# ../src/sim -mode 3 -Dvictim 8 ../traces/bzip2.mtr.gz > ../results/C.bzip2.victim8.res
+
+# MSHRs bound the misses (and prefetches) a cache has in flight, and let
+# accesses to a line still being filled merge into its miss (-Dmshr,
+# -L2mshr, or -mshr in a -hier file):
+
+# ../src/sim -mode 3 -Dprefetch stream -Dmshr 8 -L2mshr 16 ../traces/lbm.mtr.gz > ../results/C.lbm.mshr.res
+
+# -tlb 1 models per-core ITLBs and DTLBs and a shared L2 TLB; a miss in
+# both walks the page table through the data caches. The stats give
+# the TLB MPKI and the walk cycles of every core:
+
+# ../src/sim -mode 4 -tlb 1 ../traces/bzip2.mtr.gz ../traces/libq.mtr.gz > ../results/H.tlb.mix1.res
+# ../src/sim -mode 4 -tlb 1 -DTLBentries 32 -L2TLBentries 512 -L2TLBassoc 8 ../traces/bzip2.mtr.gz ../traces/libq.mtr.gz > ../results/H.tlb.small.mix1.res
+
+# -page_sizeKB 2048 maps everything with 2MB pages, -huge_pages only the
+# listed virtual address ranges. Either adds the DRAM row buffer hit rate
+# and how evenly the misses spread over each cache's sets to the stats:
+
+# ../src/sim -mode 4 -tlb 1 -page_sizeKB 4 ../traces/bzip2.mtr.gz ../traces/libq.mtr.gz > ../results/H.page4k.mix1.res
+# ../src/sim -mode 4 -tlb 1 -page_sizeKB 2048 ../traces/bzip2.mtr.gz ../traces/libq.mtr.gz > ../results/H.page2m.mix1.res
+# ../src/sim -mode 4 -tlb 1 -huge_pages 0x0-0x40000000 ../traces/bzip2.mtr.gz ../traces/libq.mtr.gz > ../results/H.hugeheap.mix1.res
+
+########## ---------------  Core model ---------------- ################
+
+# Optional: -ooo 1 replaces the blocking in-order core with an
+# out-of-order one whose loads overlap their misses (see src/core.h).
+# The stats break its stalls down into ROB-full, load-at-head and
+# fetch-starved cycles:
+
+# ../src/sim -mode 3 -ooo 1 -rob 128 -issue_width 4 -Dmshr 8 -L2mshr 16 ../traces/lbm.mtr.gz > ../results/C.lbm.ooo.res
+
+# A store buffer lets stores drain to the L1 behind the core, which then
+# only stalls when it is full. Together with the write policies of the
+# L1 (-Dwrite_allocate, -Dwrite_through; -L2... for the L2):
+
+# ../src/sim -mode 3 -store_buffer 8 ../traces/lbm.mtr.gz > ../results/C.lbm.sb.res
+# ../src/sim -mode 3 -store_buffer 8 -Dwrite_allocate 0 ../traces/lbm.mtr.gz > ../results/C.lbm.sb.nwa.res
+# ../src/sim -mode 3 -store_buffer 8 -Dwrite_through 1 -Dwrite_allocate 0 ../traces/lbm.mtr.gz > ../results/C.lbm.sb.wt.res
+
 ########## ---------------  ABC ---------------- ################
 
 # echo "Running Part A"
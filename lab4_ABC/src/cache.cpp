@@ -1,20 +1,28 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <iostream>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "cache.h"
 #include <array>
-extern uint64_t cycle;
-extern uint64_t SWP_CORE0_WAYS; 
 bool VERBOSE = false;
 
+extern void die_message(const char* msg);
+
 /////////////////////////////////////////////////////////////////////////////////////
 // ---------------------- DO NOT MODIFY THE PRINT STATS FUNCTION --------------------
 /////////////////////////////////////////////////////////////////////////////////////
 
 
-void cache_print_stats(Cache* c, char* header){
+void cache_print_stats(Cache* c, char* header, FILE* out){
 	double read_mr = 0;
 	double write_mr = 0;
 
@@ -26,15 +34,15 @@ void cache_print_stats(Cache* c, char* header){
 		write_mr = (double)(c->stat_write_miss) / (double)(c->stat_write_access);
 	}
 
-	printf("\n%s_READ_ACCESS    \t\t : %10llu", header, c->stat_read_access);
-	printf("\n%s_WRITE_ACCESS   \t\t : %10llu", header, c->stat_write_access);
-	printf("\n%s_READ_MISS      \t\t : %10llu", header, c->stat_read_miss);
-	printf("\n%s_WRITE_MISS     \t\t : %10llu", header, c->stat_write_miss);
-	printf("\n%s_READ_MISS_PERC  \t\t : %10.3f", header, 100*read_mr);
-	printf("\n%s_WRITE_MISS_PERC \t\t : %10.3f", header, 100*write_mr);
-	printf("\n%s_DIRTY_EVICTS   \t\t : %10llu", header, c->stat_dirty_evicts);
+	fprintf(out, "\n%s_READ_ACCESS    \t\t : %10llu", header, c->stat_read_access);
+	fprintf(out, "\n%s_WRITE_ACCESS   \t\t : %10llu", header, c->stat_write_access);
+	fprintf(out, "\n%s_READ_MISS      \t\t : %10llu", header, c->stat_read_miss);
+	fprintf(out, "\n%s_WRITE_MISS     \t\t : %10llu", header, c->stat_write_miss);
+	fprintf(out, "\n%s_READ_MISS_PERC  \t\t : %10.3f", header, 100*read_mr);
+	fprintf(out, "\n%s_WRITE_MISS_PERC \t\t : %10.3f", header, 100*write_mr);
+	fprintf(out, "\n%s_DIRTY_EVICTS   \t\t : %10llu", header, c->stat_dirty_evicts);
 
-	printf("\n");
+	fprintf(out, "\n");
 }
 
 
@@ -62,729 +70,1100 @@ Temporary_Cache* temporary_cache_new(uint64_t size, uint64_t assoc, uint64_t lin
 	return temporary_cache;
 	
 }
-Utility_Monitor_Struct* utility_monitor_struct_new(uint64_t size, uint64_t assoc, uint64_t linesize, uint64_t repl_policy){
-	//We need to define size, assoc, linesize, repl_policy
-	//We need to allocate memory for the cache
-	//void *calloc(size_t nitems, size_t size) where nitem is number of items and size is the size of the item
-	
-	//We allocated memory for the cache
-	Utility_Monitor_Struct *utility_monitor = (Utility_Monitor_Struct *) malloc (1 * sizeof (Utility_Monitor_Struct));
-
-	//We have cache_sets, num_sets, repl_policy, num_ways
-	//Cache size = (associativity)(number of sets)(block size)
-	//This means number of sets is cache size / (block size) * (associtiativy)
-	utility_monitor->Auxiliary_Tag_Directory = cache_new(size, utility_monitor->number_ways, linesize,utility_monitor->replacement_policy);
-	utility_monitor->number_sets = size / (linesize * assoc);
-	//We need to also allocate memory for the cache set
-	utility_monitor->replacement_policy = repl_policy; 
+Utility_Monitor_Struct* utility_monitor_struct_new(uint64_t cache_sets, uint64_t assoc, uint64_t linesize){
+	//We allocated memory for the monitor
+	Utility_Monitor_Struct *utility_monitor = (Utility_Monitor_Struct *) calloc (1, sizeof (Utility_Monitor_Struct));
+
+	//Dynamic set sampling: every sample_period-th set, CACHE_UMON_SETS of them
+	utility_monitor->number_sets = (cache_sets < CACHE_UMON_SETS) ? cache_sets : CACHE_UMON_SETS;
+	utility_monitor->sample_period = cache_sets / utility_monitor->number_sets;
+	utility_monitor->replacement_policy = CACHE_REPL_LRU; 
 	//Number of ways is associativity 
 	utility_monitor->number_ways = assoc;
+	//The tag directory is a plain LRU cache of the sampled sets: its LRU ranks are the stack positions
+	utility_monitor->Auxiliary_Tag_Directory = cache_new(utility_monitor->number_sets * assoc * linesize, assoc, linesize, CACHE_REPL_LRU, 1, NULL);
+	utility_monitor->counter = (uint64_t *) calloc (assoc, sizeof(uint64_t));
 	return utility_monitor;
 	
 }
 
-Cache* cache_new(uint64_t size, uint64_t assoc, uint64_t linesize, uint64_t repl_policy){
+Cache* cache_new(uint64_t size, uint64_t assoc, uint64_t linesize, uint64_t repl_policy, uint64_t num_cores, const uint64_t* clock){
 	//We need to define size, assoc, linesize, repl_policy
 	//We need to allocate memory for the cache
 	//void *calloc(size_t nitems, size_t size) where nitem is number of items and size is the size of the item
 	
 	//We allocated memory for the cache
-	Cache *cache = (Cache *) malloc (1 * sizeof (Cache));
+	Cache *cache = (Cache *) calloc (1, sizeof (Cache));
 
 	//We have cache_sets, num_sets, repl_policy, num_ways
 	//Cache size = (associativity)(number of sets)(block size)
 	//This means number of sets is cache size / (block size) * (associtiativy)
+	if(assoc == 0 || size < linesize * assoc)
+	{
+		die_message("A cache needs at least one set and one way");
+	}
 	cache->number_sets = size / (linesize * assoc);
-	//We need to also allocate memory for the cache set
-	cache->cache_sets  = (Cache_Set *) malloc (cache->number_sets * sizeof(Cache_Set));
 	cache->replacement_policy = repl_policy; 
 	//Number of ways is associativity 
 	cache->number_ways = assoc;
-	if(cache->replacement_policy == 4)
+	cache->sets_pow2 = (cache->number_sets & (cache->number_sets - 1)) == 0;
+	cache->set_mask = cache->number_sets - 1;
+	cache->set_shift = __builtin_ctzll(cache->number_sets);
+	cache->access_fn = cache_access_generic;
+	cache->install_fn = cache_install_generic;
+
+	//We need to also allocate memory for the tag store, see cache.h
+	cache->way_stride = (assoc + CACHE_TAG_VECTOR - 1) / CACHE_TAG_VECTOR * CACHE_TAG_VECTOR;
+	uint64_t entries = cache->number_sets * cache->way_stride;
+	cache->tags = (Addr *) aligned_alloc (CACHE_TAG_VECTOR * sizeof(Addr), entries * sizeof(Addr));
+	memset(cache->tags, 0xff, entries * sizeof(Addr));
+	cache->meta = (uint32_t *) calloc (entries, sizeof(uint32_t));
+	cache->insertion_time = (uint32_t *) calloc (entries, sizeof(uint32_t));
+	cache->num_cores = num_cores;
+	cache->clock = clock;
+
+	//Per-line state of the replacement policy, see cache.h
+	if(repl_policy >= NUM_CACHE_REPL || repl_policy == 3) //3 is unused
 	{
-		uint64_t core0 = 0;
-		uint64_t core1 = 1;
-		cache->utility_monitor_struct[core0] = utility_monitor_struct_new(size, assoc, linesize, repl_policy);
-     	cache->utility_monitor_struct[core1] = utility_monitor_struct_new(size, assoc, linesize, repl_policy);
+		die_message("Unknown replacement policy");
+	}
+	if(repl_policy == CACHE_REPL_LRU && assoc > 256)
+	{
+		die_message("LRU supports at most 256 ways");
+	}
+	if(repl_policy == CACHE_REPL_PLRU && (assoc > 64 || (assoc & (assoc - 1)) != 0))
+	{
+		die_message("PLRU needs a power-of-two associativity of at most 64");
+	}
+	cache->repl_state = (uint8_t *) calloc (entries, sizeof(uint8_t));
+	for(uint64_t ii=0; ii<entries; ii++)
+	{
+		//LRU ranks start as a permutation, RRIP lines as distant
+		cache->repl_state[ii] = (repl_policy == CACHE_REPL_LRU) ? (ii % cache->way_stride) : CACHE_RRPV_MAX;
+	}
+	if(repl_policy == CACHE_REPL_PLRU)
+	{
+		cache->plru_bits = (uint64_t *) calloc (cache->number_sets, sizeof(uint64_t));
+	}
+	cache->repl_psel = CACHE_PSEL_MAX / 2;
+	cache_seed(cache, 1);
+
+	//Way quotas for the partitioned policies: SWP (1), NEW (2) and UCP (4)
+	if(cache->replacement_policy == CACHE_REPL_SWP || cache->replacement_policy == CACHE_REPL_NEW || cache->replacement_policy == CACHE_REPL_UCP)
+	{
+		cache->way_quota = (uint64_t *) calloc (cache->num_cores, sizeof(uint64_t));
+		cache->core_cache_lines = (uint64_t *) calloc (cache->num_cores, sizeof(uint64_t));
+		cache->selected_core = (bool *) calloc (cache->num_cores, sizeof(bool));
+		cache_set_quotas(cache, 0, NULL);
+	}
+
+	if(cache->replacement_policy == CACHE_REPL_UCP)
+	{
+		if(assoc < num_cores)
+		{
+			die_message("UCP needs at least one way per core");
+		}
+		cache->utility_monitor_struct = (Utility_Monitor_Struct **) calloc (cache->num_cores, sizeof(Utility_Monitor_Struct *));
+		for(uint64_t ii=0; ii<cache->num_cores; ii++)
+		{
+			cache->utility_monitor_struct[ii] = utility_monitor_struct_new(cache->number_sets, assoc, linesize);
+		}
 	}
 	return cache;
 	
 }
 
+//Free what cache_new() and cache_set_prefetcher() allocated. What memsys attached (sdprof, prefetcher, MSHRs) is memsys's to free
+void cache_free(Cache* c){
+	free(c->tags);
+	free(c->meta);
+	free(c->insertion_time);
+	free(c->repl_state);
+	free(c->plru_bits);
+	free(c->way_quota);
+	free(c->core_cache_lines);
+	free(c->selected_core);
+	if(c->utility_monitor_struct)
+	{
+		for(uint64_t ii=0; ii<c->num_cores; ii++)
+		{
+			cache_free(c->utility_monitor_struct[ii]->Auxiliary_Tag_Directory);
+			free(c->utility_monitor_struct[ii]->counter);
+			free(c->utility_monitor_struct[ii]);
+		}
+		free(c->utility_monitor_struct);
+	}
+	free(c->ucp_log);
+	free(c->ucp_log_cycle);
+	free(c->prefetch_ready);
+	free(c);
+}
+
 
 /////////////////////////////////////////////////////////////////////////////////////
-// Return HIT if access hits in the cache, MISS otherwise 
-// Also if is_write is TRUE, then mark the resident line as dirty
-// Update appropriate stats
+// Seed the random stream of RND, BRRIP and DRRIP. splitmix64 spreads nearby
+// seeds, and keeps the xorshift state nonzero.
 /////////////////////////////////////////////////////////////////////////////////////
 
+void cache_seed(Cache* c, uint64_t seed){
+	uint64_t z = seed + 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	z = z ^ (z >> 31);
+	c->repl_rng = z ? z : 1;
+}
 
-bool cache_access(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id){
-	/*
-	is_write is true, then we need to mark it as dirty 
-	if we have a hit, then hit 
 
-	Line address is the block address. 
-	We know that block address is the byte address / bytes per block
-	index = block address / number of blocks
-	*/ 
-	uint64_t number_of_sets = c->number_sets;
-	uint64_t cache_index = (lineaddr % number_of_sets);
-	bool is_hit = false;
+/////////////////////////////////////////////////////////////////////////////////////
+// A replacement policy by number or by name, e.g. "6" or "lru". Dies if unknown.
+/////////////////////////////////////////////////////////////////////////////////////
 
-	uint64_t cache_tag = lineaddr / number_of_sets;
-	uint64_t cache_ways = c->number_ways;
-	
-	if(c->replacement_policy == 5)
-  	{
-		for(uint64_t ii=0; ii<cache_ways; ii++)
-		{
-			if ((c->cache_sets[cache_index].cache_line[ii].valid == true) && (c->cache_sets[cache_index].cache_line[ii].tag == cache_tag) && (c->cache_sets[cache_index].cache_line[ii].core_id == 0))
-			{
-				is_hit = true;
-				// Also if is_write is TRUE, then mark the resident line as dirty
-				if(is_write)
-				{
-					c->cache_sets[cache_index].cache_line[ii].dirty = true;
-				}
-			}
-		}
+static const char* cache_repl_names[NUM_CACHE_REPL] = {
+	"fifo", "swp", "new", NULL, "ucp", "core0", "lru", "plru", "rnd", "srrip", "brrip", "drrip",
+};
 
-		//Update appropriate stats
-		if(is_write)
+uint64_t cache_repl_parse(const char* s){
+	if(s[0] >= '0' && s[0] <= '9')
+	{
+		uint64_t policy = strtoull(s, NULL, 10);
+		if(policy < NUM_CACHE_REPL && cache_repl_names[policy] != NULL)
 		{
-			c->stat_write_access++;
-			if(is_hit == false)
-			{
-				if(VERBOSE == true)
-				{
-					std::cout << "stat_write_miss" << c->stat_write_miss << std::endl;
-				}
-				c->stat_write_miss++;
-			}
+			return policy;
 		}
-		else
+	}
+	for(uint64_t ii=0; ii<NUM_CACHE_REPL; ii++)
+	{
+		if(cache_repl_names[ii] != NULL && !strcasecmp(s, cache_repl_names[ii]))
 		{
-			c->stat_read_access++;
-			if(is_hit == false)
-			{
-				if(VERBOSE == true)
-				{
-					std::cout << "stat_read_miss" << c->stat_read_miss << std::endl;
-				}
-				c->stat_read_miss++;
-			}
+			return ii;
 		}
+	}
+	printf("Replacement policy is %s\n", s);
+	die_message("Unknown replacement policy");
+	return 0;
+}
 
-		// Return HIT if access hits in the cache, MISS otherwise 
-		if(is_hit == false)
-		{
-			return false;
-		}
-		else
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Way quotas of the partitioned policies: SWP takes the per-core quotas if
+// given, else core0_ways for core 0. NEW is SWP with core 0 fixed at 12 ways.
+// UCP starts from an even split until its first repartition
+/////////////////////////////////////////////////////////////////////////////////////
+
+void cache_set_quotas(Cache* c, uint64_t core0_ways, uint64_t* quotas){
+	if(c->way_quota == NULL)
+	{
+		return;
+	}
+
+	if(c->replacement_policy == CACHE_REPL_SWP && quotas != NULL)
+	{
+		for(uint64_t ii=0; ii<c->num_cores; ii++)
 		{
-			return true;
+			c->way_quota[ii] = quotas[ii];
 		}
+	}
+	else if(c->replacement_policy == CACHE_REPL_UCP)
+	{
+		cache_set_core0_quota(c, c->number_ways / c->num_cores);
+	}
+	else
+	{
+		cache_set_core0_quota(c, (c->replacement_policy == CACHE_REPL_NEW) ? 12 : core0_ways);
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Core 0 gets core0_ways, the remaining ways are split evenly between the
+// other cores (lower core ids get the leftover ways)
+/////////////////////////////////////////////////////////////////////////////////////
+
+void cache_set_core0_quota(Cache* c, uint64_t core0_ways){
+	c->way_quota[0] = core0_ways;
+	if(c->num_cores == 1)
+	{
+		return;
+	}
+
+	uint64_t others = c->num_cores - 1;
+	uint64_t rest = (c->number_ways > core0_ways) ? (c->number_ways - core0_ways) : 0;
+	for(uint64_t ii=1; ii<c->num_cores; ii++)
+	{
+		c->way_quota[ii] = rest / others + ((ii-1) < (rest % others) ? 1 : 0);
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////
+// The lookup, install and victim paths below are templates on the cache
+// geometry and policy, so that common configurations get code where the
+// associativity is a constant (loops unroll), index and tag are a mask and a
+// shift, and the policy checks fold away. ASSOC 0, POW2 false and POLICY
+// CACHE_ANY_POLICY read all three from the Cache at runtime: that is the
+// generic path every cache starts with. cache_specialize() picks the rest.
+/////////////////////////////////////////////////////////////////////////////////////
+
+#define CACHE_ANY_ASSOC   0
+#define CACHE_ANY_POLICY  -1
+
+template<uint32_t ASSOC>
+static inline uint64_t cache_ways(Cache* c){
+	return ASSOC ? ASSOC : c->number_ways;
+}
+
+template<uint32_t ASSOC>
+static inline uint64_t cache_stride(Cache* c){
+	return ASSOC ? (ASSOC + CACHE_TAG_VECTOR - 1) / CACHE_TAG_VECTOR * CACHE_TAG_VECTOR : c->way_stride;
+}
+
+template<int POLICY>
+static inline uint64_t cache_policy(Cache* c){
+	return (POLICY >= 0) ? POLICY : c->replacement_policy;
+}
+
+template<bool POW2>
+static inline uint64_t cache_set_index(Cache* c, Addr lineaddr){
+	return POW2 ? (lineaddr & c->set_mask) : (lineaddr % c->number_sets);
+}
+
+template<bool POW2>
+static inline Addr cache_tag(Cache* c, Addr lineaddr){
+	return POW2 ? (lineaddr >> c->set_shift) : (lineaddr / c->number_sets);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Bit w of the result is set if tags[w] == tag, for the CACHE_TAG_VECTOR
+// tags starting at tags (aligned)
+/////////////////////////////////////////////////////////////////////////////////////
 
-		for(uint64_t ii=0; ii<cache_ways; ii++)
+static inline uint32_t cache_match_tags(const Addr* tags, Addr tag){
+#if defined(__AVX2__)
+	__m256i eq = _mm256_cmpeq_epi64(_mm256_load_si256((const __m256i*)tags), _mm256_set1_epi64x(tag));
+	return _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+#elif defined(__SSE2__)
+	//SSE2 has no 64-bit compare: a tag matches if both of its 32-bit halves do
+	__m128i key = _mm_set1_epi64x(tag);
+	__m128i lo = _mm_cmpeq_epi32(_mm_load_si128((const __m128i*)tags), key);
+	__m128i hi = _mm_cmpeq_epi32(_mm_load_si128((const __m128i*)(tags+2)), key);
+	lo = _mm_and_si128(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2,3,0,1)));
+	hi = _mm_and_si128(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2,3,0,1)));
+	return _mm_movemask_pd(_mm_castsi128_pd(lo)) | (_mm_movemask_pd(_mm_castsi128_pd(hi)) << 2);
+#else
+	uint32_t mask = 0;
+	for(uint32_t ii=0; ii<CACHE_TAG_VECTOR; ii++)
+	{
+		mask |= (uint32_t)(tags[ii] == tag) << ii;
+	}
+	return mask;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// First way at or after start_way holding tag and owned by owner (any core if
+// owner is negative). Returns -1 if there is none.
+/////////////////////////////////////////////////////////////////////////////////////
+
+template<uint32_t ASSOC>
+static inline int cache_find_way(Cache* c, uint64_t set_index, Addr tag, int64_t owner, uint64_t start_way){
+	uint64_t cache_ways_n = cache_ways<ASSOC>(c);
+	uint64_t set_base = set_index * cache_stride<ASSOC>(c);
+	const Addr* tags = &c->tags[set_base];
+
+	for(uint64_t ww = start_way & ~(uint64_t)(CACHE_TAG_VECTOR-1); ww < cache_ways_n; ww += CACHE_TAG_VECTOR)
+	{
+		uint32_t mask = cache_match_tags(&tags[ww], tag);
+		if(ww < start_way)
 		{
-			if ((c->cache_sets[cache_index].cache_line[ii].valid == true) && (c->cache_sets[cache_index].cache_line[ii].tag == cache_tag) && (c->cache_sets[cache_index].cache_line[ii].core_id == 1))
-			{
-				is_hit = true;
-				// Also if is_write is TRUE, then mark the resident line as dirty
-				if(is_write)
-				{
-					c->cache_sets[cache_index].cache_line[ii].dirty = true;
-				}
-			}
+			mask &= ~0u << (start_way - ww);
 		}
-
-		//Update appropriate stats
-		if(is_write)
+		while(mask)
 		{
-			c->stat_write_access++;
-			if(is_hit == false)
+			uint64_t way = ww + __builtin_ctz(mask);
+			if(way >= cache_ways_n)
 			{
-				if(VERBOSE == true)
-				{
-					std::cout << "stat_write_miss" << c->stat_write_miss << std::endl;
-				}
-				c->stat_write_miss++;
+				return -1;
 			}
-		}
-		else
-		{
-			c->stat_read_access++;
-			if(is_hit == false)
+			if(owner < 0 || (c->meta[set_base + way] >> CACHE_META_OWNER_SHIFT) == (uint64_t)owner)
 			{
-				if(VERBOSE == true)
-				{
-					std::cout << "stat_read_miss" << c->stat_read_miss << std::endl;
-				}
-				c->stat_read_miss++;
+				return way;
 			}
+			mask &= mask - 1;
 		}
+	}
+	return -1;
+}
 
-		// Return HIT if access hits in the cache, MISS otherwise 
-		if(is_hit == false)
-		{
-			return false;
-		}
-		else
-		{
-			return true;
-		}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Replacement policy hooks: on a hit, on an insert, and the victim among the
+// valid ways of a full set (see Cache_Repl in cache.h). With POLICY fixed
+// the switch statements fold to the one policy.
+/////////////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t cache_rng_next(Cache* c){
+	//xorshift64*
+	uint64_t x = c->repl_rng;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	c->repl_rng = x;
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+//The way becomes MRU; the ways that were more recent age by one
+template<uint32_t ASSOC>
+static inline void cache_lru_touch(Cache* c, uint64_t set_index, uint64_t way){
+	uint8_t* rank = &c->repl_state[set_index * cache_stride<ASSOC>(c)];
+	uint8_t old_rank = rank[way];
+	for(uint64_t ww=0; ww<cache_ways<ASSOC>(c); ww++)
+	{
+		rank[ww] += (rank[ww] < old_rank);
 	}
-	
-	if(c->replacement_policy == 2)
-  	{
-		SWP_CORE0_WAYS = 12;
-	}
-	if(c->replacement_policy == 4)
-  	{
-		uint64_t counter = 0;
-		uint64_t partition_cycle = 5000000;
-		if(partition_cycle/cycle == 0)
-		{
-			counter++;
-		}
-		else
-		{
-			counter = counter/2;
-			counter++;
-		}
+	rank[way] = 0;
+}
+
+//Point every tree node on the way's path away from it
+template<uint32_t ASSOC>
+static inline void cache_plru_touch(Cache* c, uint64_t set_index, uint64_t way){
+	uint64_t ways = cache_ways<ASSOC>(c);
+	uint64_t bits = c->plru_bits[set_index];
+	uint64_t node = 1;
+	for(uint64_t half = ways >> 1; half; half >>= 1)
+	{
+		uint64_t right = (way & half) != 0;
+		bits = right ? (bits & ~(1ULL << node)) : (bits | (1ULL << node));
+		node = 2*node + right;
+	}
+	c->plru_bits[set_index] = bits;
+}
+
+//DRRIP: 1 if the set leads for SRRIP, 2 for BRRIP, 0 if it follows psel
+static inline int cache_drrip_leader(uint64_t set_index){
+	uint64_t slot = set_index % CACHE_DUEL_SETS;
+	return (slot == 0) ? 1 : (slot == 1) ? 2 : 0;
+}
 
-		uint64_t utility_ways = c->utility_monitor_struct[core_id]->number_ways;
-		uint64_t core0;
-		uint64_t core1;
-		uint64_t ii = 0;
-		while(ii<utility_ways)
+static inline uint8_t cache_brrip_rrpv(Cache* c){
+	return (cache_rng_next(c) % CACHE_BRRIP_LONG_ODDS == 0) ? CACHE_RRPV_MAX - 1 : CACHE_RRPV_MAX;
+}
+
+template<uint32_t ASSOC, int POLICY>
+static inline void cache_repl_on_hit(Cache* c, uint64_t set_index, uint64_t way){
+	switch(cache_policy<POLICY>(c))
+	{
+		case CACHE_REPL_LRU:
+			cache_lru_touch<ASSOC>(c, set_index, way);
+			break;
+		case CACHE_REPL_PLRU:
+			cache_plru_touch<ASSOC>(c, set_index, way);
+			break;
+		case CACHE_REPL_SRRIP:
+		case CACHE_REPL_BRRIP:
+		case CACHE_REPL_DRRIP:
+			c->repl_state[set_index * cache_stride<ASSOC>(c) + way] = 0;
+			break;
+		default:
+			break;
+	}
+}
+
+template<uint32_t ASSOC, int POLICY>
+static inline void cache_repl_on_insert(Cache* c, uint64_t set_index, uint64_t way){
+	uint8_t* rrpv = &c->repl_state[set_index * cache_stride<ASSOC>(c) + way];
+	switch(cache_policy<POLICY>(c))
+	{
+		case CACHE_REPL_LRU:
+			cache_lru_touch<ASSOC>(c, set_index, way);
+			break;
+		case CACHE_REPL_PLRU:
+			cache_plru_touch<ASSOC>(c, set_index, way);
+			break;
+		case CACHE_REPL_SRRIP:
+			*rrpv = CACHE_RRPV_MAX - 1;
+			break;
+		case CACHE_REPL_BRRIP:
+			*rrpv = cache_brrip_rrpv(c);
+			break;
+		case CACHE_REPL_DRRIP:
 		{
-			if(c->cache_sets[cache_index].cache_line[ii].core_id == 0)
+			//An insert is a miss: it counts against the leader's policy
+			int leader = cache_drrip_leader(set_index);
+			if(leader == 1 && c->repl_psel < CACHE_PSEL_MAX)
 			{
-
-				core0++;
+				c->repl_psel++;
 			}
-			if(c->cache_sets[cache_index].cache_line[ii].core_id == 1)
+			else if(leader == 2 && c->repl_psel > 0)
 			{
-				core1++;
+				c->repl_psel--;
 			}
-			ii++;
+			bool use_brrip = (leader == 0) ? (c->repl_psel > CACHE_PSEL_MAX / 2) : (leader == 2);
+			*rrpv = use_brrip ? cache_brrip_rrpv(c) : CACHE_RRPV_MAX - 1;
+			break;
 		}
-		
+		default:
+			break;
+	}
+}
 
-		for(uint64_t ii=0; ii<cache_ways; ii++)
+template<uint32_t ASSOC>
+static int cache_find_oldest_way_spec(Cache *c, uint32_t set_index, bool *eligible);
+
+template<uint32_t ASSOC, int POLICY>
+static inline uint64_t cache_repl_victim(Cache* c, uint64_t set_index){
+	uint64_t ways = cache_ways<ASSOC>(c);
+	uint8_t* state = &c->repl_state[set_index * cache_stride<ASSOC>(c)];
+	switch(cache_policy<POLICY>(c))
+	{
+		case CACHE_REPL_LRU:
 		{
-			
-			if ((c->cache_sets[cache_index].cache_line[ii].valid == true) && (c->cache_sets[cache_index].cache_line[ii].tag == cache_tag))
+			for(uint64_t ww=0; ww<ways; ww++)
 			{
-				is_hit = true;
-				// Also if is_write is TRUE, then mark the resident line as dirty
-				if(is_write)
+				if(state[ww] == ways - 1)
 				{
-					c->cache_sets[cache_index].cache_line[ii].dirty = true;
+					return ww;
 				}
 			}
+			assert(false);
+			return 0;
 		}
-
-		//Update appropriate stats
-		if(is_write)
+		case CACHE_REPL_PLRU:
 		{
-			c->stat_write_access++;
-			if(is_hit == false)
+			uint64_t bits = c->plru_bits[set_index];
+			uint64_t node = 1;
+			uint64_t way = 0;
+			for(uint64_t half = ways >> 1; half; half >>= 1)
 			{
-				if(VERBOSE == true)
-				{
-					std::cout << "stat_write_miss" << c->stat_write_miss << std::endl;
-				}
-				c->stat_write_miss++;
+				uint64_t right = (bits >> node) & 1;
+				way |= right ? half : 0;
+				node = 2*node + right;
 			}
+			return way;
 		}
-		else
+		case CACHE_REPL_RND:
+			return cache_rng_next(c) % ways;
+		case CACHE_REPL_SRRIP:
+		case CACHE_REPL_BRRIP:
+		case CACHE_REPL_DRRIP:
 		{
-			c->stat_read_access++;
-			if(is_hit == false)
+			//Age the whole set until some line is predicted distant, then
+			//take the first such line
+			uint8_t max_rrpv = 0;
+			for(uint64_t ww=0; ww<ways; ww++)
+			{
+				max_rrpv = (state[ww] > max_rrpv) ? state[ww] : max_rrpv;
+			}
+			uint8_t age = CACHE_RRPV_MAX - max_rrpv;
+			uint64_t victim = ways;
+			for(uint64_t ww=0; ww<ways; ww++)
 			{
-				if(VERBOSE == true)
+				state[ww] += age;
+				if(victim == ways && state[ww] == CACHE_RRPV_MAX)
 				{
-					std::cout << "stat_read_miss" << c->stat_read_miss << std::endl;
+					victim = ww;
 				}
-				c->stat_read_miss++;
 			}
+			return victim;
 		}
-
-		// Return HIT if access hits in the cache, MISS otherwise 
-		if(is_hit == false)
-		{
-			return false;
-		}
-		else
+		default:
 		{
-			return true;
+			//FIFO
+			int fifo_set_index = cache_find_oldest_way_spec<ASSOC>(c, set_index, NULL);
+			assert(fifo_set_index >= 0);
+			return fifo_set_index;
 		}
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////
+// UCP (Qureshi and Patt, MICRO 2006). Every access of a core to a sampled
+// set also goes to that core's utility monitor, and every ucp_epoch_cycles
+// the lookahead algorithm turns the monitors' hit counters into the way
+// quotas that cache_find_victim_partitioned() enforces.
+/////////////////////////////////////////////////////////////////////////////////////
 
-		for(uint64_t ii=0; ii<cache_ways; ii++)
+static void cache_umon_access(Utility_Monitor_Struct* um, uint64_t set_index, Addr tag){
+	if(set_index % um->sample_period != 0 || set_index / um->sample_period >= um->number_sets)
+	{
+		return;
+	}
+	Cache* atd = um->Auxiliary_Tag_Directory;
+	uint64_t atd_set = set_index / um->sample_period;
+	uint64_t set_base = atd_set * atd->way_stride;
+
+	int way = cache_find_way<CACHE_ANY_ASSOC>(atd, atd_set, tag, -1, 0);
+	if(way >= 0)
+	{
+		um->counter[atd->repl_state[set_base + way]]++;
+	}
+	else
+	{
+		way = cache_find_way<CACHE_ANY_ASSOC>(atd, atd_set, CACHE_INVALID_TAG, -1, 0);
+		if(way < 0)
 		{
-			if ((c->cache_sets[cache_index].cache_line[ii].valid == true) && (c->cache_sets[cache_index].cache_line[ii].tag == cache_tag) && (c->cache_sets[cache_index].cache_line[ii].core_id == 1))
-			{
-				is_hit = true;
-				// Also if is_write is TRUE, then mark the resident line as dirty
-				if(is_write)
-				{
-					c->cache_sets[cache_index].cache_line[ii].dirty = true;
-				}
-			}
+			way = cache_repl_victim<CACHE_ANY_ASSOC, CACHE_REPL_LRU>(atd, atd_set);
 		}
+		atd->tags[set_base + way] = tag;
+		atd->meta[set_base + way] = CACHE_META_VALID;
+	}
+	cache_lru_touch<CACHE_ANY_ASSOC>(atd, atd_set, way);
+}
+
+static void cache_ucp_access(Cache* c, uint64_t set_index, Addr tag, uint32_t core_id){
+	if(c->ucp_epoch_cycles && c->clock && *c->clock >= c->ucp_next_epoch)
+	{
+		cache_ucp_repartition(c);
+		c->ucp_next_epoch = *c->clock - (*c->clock % c->ucp_epoch_cycles) + c->ucp_epoch_cycles;
+	}
+	cache_umon_access(c->utility_monitor_struct[core_id], set_index, tag);
+}
 
-		//Update appropriate stats
-		if(is_write)
+/////////////////////////////////////////////////////////////////////////////////////
+// Lookahead partitioning: every core gets one way, then the remaining ways go,
+// a block at a time, to the core whose best block has the most extra hits per
+// way. The counters are halved afterwards so older epochs fade out.
+/////////////////////////////////////////////////////////////////////////////////////
+
+void cache_ucp_repartition(Cache* c){
+	uint64_t num_cores = c->num_cores;
+	uint64_t *alloc = c->way_quota;
+	for(uint64_t ii=0; ii<num_cores; ii++)
+	{
+		alloc[ii] = 1;
+	}
+
+	uint64_t balance = c->number_ways - num_cores;
+	while(balance > 0)
+	{
+		uint64_t best_core = 0;
+		uint64_t best_ways = 0;
+		double best_mu = 0;
+		for(uint64_t ii=0; ii<num_cores; ii++)
 		{
-			c->stat_write_access++;
-			if(is_hit == false)
+			uint64_t *counter = c->utility_monitor_struct[ii]->counter;
+			uint64_t hits = 0;
+			for(uint64_t kk=1; kk<=balance; kk++)
 			{
-				if(VERBOSE == true)
+				hits += counter[alloc[ii] + kk - 1];
+				double mu = (double)hits / kk;
+				if(mu > best_mu)
 				{
-					std::cout << "stat_write_miss" << c->stat_write_miss << std::endl;
+					best_mu = mu;
+					best_core = ii;
+					best_ways = kk;
 				}
-				c->stat_write_miss++;
 			}
 		}
-		else
+		if(best_ways == 0)
 		{
-			c->stat_read_access++;
-			if(is_hit == false)
+			//No core gains from more ways: share out the rest evenly
+			for(uint64_t ii=0; balance > 0; ii = (ii + 1) % num_cores, balance--)
 			{
-				if(VERBOSE == true)
-				{
-					std::cout << "stat_read_miss" << c->stat_read_miss << std::endl;
-				}
-				c->stat_read_miss++;
+				alloc[ii]++;
 			}
+			break;
 		}
+		alloc[best_core] += best_ways;
+		balance -= best_ways;
+	}
 
-		// Return HIT if access hits in the cache, MISS otherwise 
-		if(is_hit == false)
-		{
-			return false;
-		}
-		else
+	for(uint64_t ii=0; ii<num_cores; ii++)
+	{
+		uint64_t *counter = c->utility_monitor_struct[ii]->counter;
+		for(uint64_t ww=0; ww<c->number_ways; ww++)
 		{
-			return true;
+			counter[ww] /= 2;
 		}
 	}
 
-	for(uint64_t ii=0; ii<cache_ways; ii++)
+	//Keep the decision for the stats
+	if(c->ucp_epochs == c->ucp_log_size)
 	{
-		if ((c->cache_sets[cache_index].cache_line[ii].valid == true) && (c->cache_sets[cache_index].cache_line[ii].tag == cache_tag) && (c->cache_sets[cache_index].cache_line[ii].core_id == core_id))
-		{
-			is_hit = true;
-			// Also if is_write is TRUE, then mark the resident line as dirty
-			if(is_write)
-			{
-				c->cache_sets[cache_index].cache_line[ii].dirty = true;
-			}
-		}
+		c->ucp_log_size = c->ucp_log_size ? 2 * c->ucp_log_size : 64;
+		c->ucp_log = (uint64_t *) realloc (c->ucp_log, c->ucp_log_size * num_cores * sizeof(uint64_t));
+		c->ucp_log_cycle = (uint64_t *) realloc (c->ucp_log_cycle, c->ucp_log_size * sizeof(uint64_t));
 	}
+	memcpy(&c->ucp_log[c->ucp_epochs * num_cores], alloc, num_cores * sizeof(uint64_t));
+	c->ucp_log_cycle[c->ucp_epochs] = *c->clock;
+	c->ucp_epochs++;
+}
 
-	//Update appropriate stats
-	if(is_write)
+/////////////////////////////////////////////////////////////////////////////////////
+// The way quotas chosen at every repartition, and their average per core
+/////////////////////////////////////////////////////////////////////////////////////
+
+void cache_print_ucp_stats(Cache* c, char* header, FILE* out){
+	fprintf(out, "\n%s_UCP_EPOCHS     \t\t : %10llu", header, (unsigned long long)c->ucp_epochs);
+	for(uint64_t ee=0; ee<c->ucp_epochs; ee++)
 	{
-		c->stat_write_access++;
-		if(is_hit == false)
+		fprintf(out, "\n%s_UCP_EPOCH_%-4llu \t : %10llu  ways", header, (unsigned long long)ee, (unsigned long long)c->ucp_log_cycle[ee]);
+		for(uint64_t ii=0; ii<c->num_cores; ii++)
 		{
-			if(VERBOSE == true)
-			{
-				std::cout << "stat_write_miss" << c->stat_write_miss << std::endl;
-			}
-			c->stat_write_miss++;
+			fprintf(out, " %llu", (unsigned long long)c->ucp_log[ee * c->num_cores + ii]);
 		}
 	}
-	else
+	for(uint64_t ii=0; ii<c->num_cores; ii++)
 	{
-		c->stat_read_access++;
-		if(is_hit == false)
+		double avg_ways = (double)c->way_quota[ii];
+		if(c->ucp_epochs)
 		{
-			if(VERBOSE == true)
+			uint64_t sum = 0;
+			for(uint64_t ee=0; ee<c->ucp_epochs; ee++)
 			{
-				std::cout << "stat_read_miss" << c->stat_read_miss << std::endl;
+				sum += c->ucp_log[ee * c->num_cores + ii];
 			}
-			c->stat_read_miss++;
+			avg_ways = (double)sum / c->ucp_epochs;
 		}
+		fprintf(out, "\n%s_UCP_CORE_%llu_AVG_WAYS \t : %10.3f", header, (unsigned long long)ii, avg_ways);
 	}
+	fprintf(out, "\n");
+}
 
-	// Return HIT if access hits in the cache, MISS otherwise 
-	if(is_hit == false)
+
+/////////////////////////////////////////////////////////////////////////////////////
+// A line only hits for the core that installed it, except that UCP hits on
+// any core's line and CORE0 only on core 0's lines. Returns the owner to
+// match, -1 for any.
+/////////////////////////////////////////////////////////////////////////////////////
+
+static inline int64_t cache_hit_owner(uint64_t policy, uint32_t core_id){
+	if(policy == CACHE_REPL_UCP)
 	{
-		return false;
+		return -1;
 	}
-	else
+	if(policy == CACHE_REPL_CORE0)
 	{
-		return true;
+		return 0;
 	}
+	return core_id;
 }
 
 
 /////////////////////////////////////////////////////////////////////////////////////
-// Install the line: determine victim using replacement policy
-// Copy victim into last_evicted_line for tracking writebacks
+// Prefetched lines (see prefetch.h): the first demand access makes the
+// prefetch useful, and late if the fill is still under way at the
+// access's cycle. cache_access() only notes the hit; the caller, which
+// knows that cycle, settles it with cache_prefetch_hit()
 /////////////////////////////////////////////////////////////////////////////////////
 
+void cache_set_prefetcher(Cache* c, Prefetcher* pf){
+	c->prefetcher = pf;
+	c->prefetch_ready = (uint64_t *) calloc (c->number_sets * c->way_stride, sizeof(uint64_t));
+}
 
-void cache_install(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id){
+//The last cache_access(), at cycle, was the first use of a prefetched line: returns the cycles it waits for the fill
+uint64_t cache_prefetch_hit(Cache* c, uint64_t cycle){
+	c->prefetcher->stat_useful++;
+	if(cycle < c->last_hit_ready)
+	{
+		c->prefetcher->stat_late++;
+		return c->last_hit_ready - cycle;
+	}
+	return 0;
+}
 
-  	// Find victim using cache_find_victim()
-	//Fix this !!! number_sets
-	uint64_t number_of_sets = c->number_sets;
-	uint64_t cache_index = (lineaddr % number_of_sets);
-	uint64_t cache_tag = lineaddr / number_of_sets;
+//Does the cache hold the line for core_id? No stats, no replacement update
+bool cache_probe(Cache* c, Addr lineaddr, uint32_t core_id){
+	uint64_t cache_index = cache_set_index<false>(c, lineaddr);
+	Addr cache_tag_bits = cache_tag<false>(c, lineaddr);
+	return cache_find_way<CACHE_ANY_ASSOC>(c, cache_index, cache_tag_bits, cache_hit_owner(c->replacement_policy, core_id), 0) >= 0;
+}
 
-	uint64_t victim_way = cache_find_victim(c, cache_index, core_id);
+//Flag the line core_id just installed as prefetched, arriving at ready_cycle
+void cache_mark_prefetch(Cache* c, Addr lineaddr, uint32_t core_id, uint64_t ready_cycle){
+	uint64_t cache_index = cache_set_index<false>(c, lineaddr);
+	Addr cache_tag_bits = cache_tag<false>(c, lineaddr);
+	int way = cache_find_way<CACHE_ANY_ASSOC>(c, cache_index, cache_tag_bits, core_id, 0);
+	assert(way >= 0);
+	uint64_t line = cache_index * c->way_stride + way;
+	c->meta[line] |= CACHE_META_PREFETCH;
+	c->prefetch_ready[line] = ready_cycle;
+}
 
-	if(VERBOSE == true)
-	{
-		std::cout << "victim way" << victim_way << std::endl;
-	}
 
-	// Copy victim into last_evicted_line for tracking writebacks
-	c->last_evicted_line = c->cache_sets[cache_index].cache_line[victim_way];
-	//Update stats
-	if (c->cache_sets[cache_index].cache_line[victim_way].dirty == true)
+/////////////////////////////////////////////////////////////////////////////////////
+// Drop every copy of the line, whichever core owns it (back-invalidation
+// and exclusive caches, see memsys.cpp). Returns the meta bits of the
+// copies or-ed together: 0 if the cache did not hold the line.
+/////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t cache_invalidate(Cache* c, Addr lineaddr){
+	uint64_t cache_index = cache_set_index<false>(c, lineaddr);
+	Addr cache_tag_bits = cache_tag<false>(c, lineaddr);
+	uint32_t found = 0;
+	int way = cache_find_way<CACHE_ANY_ASSOC>(c, cache_index, cache_tag_bits, -1, 0);
+	while(way >= 0)
 	{
-		if(VERBOSE == true)
+		uint64_t line = cache_index * c->way_stride + way;
+		found |= c->meta[line];
+		if(c->meta[line] & CACHE_META_PREFETCH)
 		{
-			std::cout << "dirty evicts" << c->stat_dirty_evicts << std::endl;
+			c->prefetcher->stat_useless++;
 		}
-		c->stat_dirty_evicts++;
+		c->tags[line] = CACHE_INVALID_TAG;
+		c->meta[line] = 0;
+		way = cache_find_way<CACHE_ANY_ASSOC>(c, cache_index, cache_tag_bits, -1, way+1);
 	}
+	return found;
+}
 
-	//Update the other values 
-	c->cache_sets[cache_index].cache_line[victim_way].valid = true;
-  	c->cache_sets[cache_index].cache_line[victim_way].tag = cache_tag;
-	if(is_write) 
-	{
-		c->cache_sets[cache_index].cache_line[victim_way].dirty = true;
-	} 
-	else 
+//A write-through cache passed the write on: its copy of the line stays clean
+void cache_clean(Cache* c, Addr lineaddr){
+	uint64_t cache_index = cache_set_index<false>(c, lineaddr);
+	Addr cache_tag_bits = cache_tag<false>(c, lineaddr);
+	int way = cache_find_way<CACHE_ANY_ASSOC>(c, cache_index, cache_tag_bits, -1, 0);
+	while(way >= 0)
 	{
-		c->cache_sets[cache_index].cache_line[victim_way].dirty = false;
+		c->meta[cache_index * c->way_stride + way] &= ~CACHE_META_DIRTY;
+		way = cache_find_way<CACHE_ANY_ASSOC>(c, cache_index, cache_tag_bits, -1, way+1);
 	}
-  	c->cache_sets[cache_index].cache_line[victim_way].core_id = core_id;
-  	c->cache_sets[cache_index].cache_line[victim_way].insertion_time = cycle;
+}
 
+//Line addresses of all valid lines into lineaddrs (room for sets*ways), returns how many
+uint64_t cache_valid_lines(Cache* c, Addr* lineaddrs){
+	uint64_t n = 0;
+	for(uint64_t set=0; set<c->number_sets; set++)
+	{
+		for(uint64_t way=0; way<c->number_ways; way++)
+		{
+			uint64_t line = set * c->way_stride + way;
+			if(c->meta[line] & CACHE_META_VALID)
+			{
+				lineaddrs[n++] = c->tags[line] * c->number_sets + set;
+			}
+		}
+	}
+	return n;
 }
 
 
 /////////////////////////////////////////////////////////////////////////////////////
-// You may find it useful to split victim selection from install
+// Return HIT if access hits in the cache, MISS otherwise 
+// Also if is_write is TRUE, then mark the resident line as dirty
+// Update appropriate stats
 /////////////////////////////////////////////////////////////////////////////////////
 
 
-uint32_t cache_find_victim(Cache *c, uint32_t set_index, uint32_t core_id)
-{
-// 0:FIFO 1:SWP (Part E)  2:NEW (Part F) 
+template<uint32_t ASSOC, bool POW2, int POLICY>
+static bool cache_access_spec(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id){
+	/*
+	is_write is true, then we need to mark it as dirty 
+	if we have a hit, then hit 
 
-	//There is space in the cache  
-	uint64_t cache_ways = c->number_ways;
-	for(uint64_t ii = 0; ii<cache_ways; ii++)
+	Line address is the block address. 
+	We know that block address is the byte address / bytes per block
+	index = block address / number of blocks
+	*/ 
+	uint64_t cache_index = cache_set_index<POW2>(c, lineaddr);
+	uint64_t cache_tag_bits = cache_tag<POW2>(c, lineaddr);
+	uint64_t policy = cache_policy<POLICY>(c);
+	bool is_hit = false;
+
+	if(c->sdprof)
 	{
-		if(c->cache_sets[set_index].cache_line[ii].valid == false)
-		{	
-			return ii;
-		}
-	}
-	//FIFO
-	
-	if(c->replacement_policy == 0)
-	{	
-		bool valid = false;
-		int fifo_set_index = -1;
-		uint64_t oldest_insertion_time = -1; 
-		int cache_ways = c->number_ways;
-
-		//Similar implementation to the last lab for finding the oldest instruction time
-		int jj = 0;
-		while(jj<cache_ways)
-		{
-			if(c->cache_sets[set_index].cache_line[jj].valid == true)
-			{	
-				uint32_t new_insertion_time = c->cache_sets[set_index].cache_line[jj].insertion_time;
-				if(fifo_set_index == -1 || new_insertion_time < oldest_insertion_time)
-				{
-					oldest_insertion_time = new_insertion_time;
-					fifo_set_index = jj;
-					valid = true;
-				}
-			}
-			jj++;
-		}
-		if(valid == true)
-		{
-			if(VERBOSE == true)
-			{
-				std::cout << "set" << set_index << std::endl;
-				std::cout << fifo_set_index << std::endl;
-			}
-			
-			return fifo_set_index;
-		}
-		else
-		{
-			assert(false);
-		}
+		sdprof_access(c->sdprof, lineaddr);
 	}
 
-	//SWP
-	if(c->replacement_policy == 1)
+	if(policy == CACHE_REPL_UCP)
 	{
-		bool valid = false;
-		int fifo_set_index = -1;
-		uint64_t oldest_insertion_time = -1; 
-		int cache_ways = c->number_ways;
+		cache_ucp_access(c, cache_index, cache_tag_bits, core_id);
+	}
 
-		//Based on the lab description
-		uint64_t quota_for_core0 = 0;
-    	//uint64_t quote_for_core1 = 0;
-		quota_for_core0 = SWP_CORE0_WAYS; //4
-    	//quote_for_core1 = N - SWP_CORE0_WAYS;
-		uint64_t core0 = 0;
-		uint64_t core1 = 1;
+	int64_t owner = cache_hit_owner(policy, core_id);
 
-		//How many core 0 cache lines are there? 
-		uint64_t core0_cache_lines = 0;
-		uint64_t core1_cache_lines = 0;
-		int xx = 0;
-		while(xx<cache_ways)
+	uint64_t set_base = cache_index * cache_stride<ASSOC>(c);
+	int way = cache_find_way<ASSOC>(c, cache_index, cache_tag_bits, owner, 0);
+	c->last_hit_prefetch = false;
+	if(way >= 0)
+	{
+		cache_repl_on_hit<ASSOC, POLICY>(c, cache_index, way);
+		if(c->meta[set_base + way] & CACHE_META_PREFETCH)
 		{
-			if(c->cache_sets[set_index].cache_line[xx].core_id == 0)
-			{
-				core0_cache_lines++;
-			}
-			if(c->cache_sets[set_index].cache_line[xx].core_id == 1)
-			{
-				core1_cache_lines++;
-			}
-
-			xx++;
+			c->meta[set_base + way] &= ~CACHE_META_PREFETCH;
+			c->last_hit_prefetch = true;
+			c->last_hit_ready = c->prefetch_ready[set_base + way];
 		}
-		if(VERBOSE == true)
+	}
+	while(way >= 0)
+	{
+		is_hit = true;
+		// Also if is_write is TRUE, then mark the resident line as dirty
+		if(!is_write)
 		{
-			std::cout << "core cache line " << core0_cache_lines << std::endl;
-			std::cout << "cache way count" << xx << std::endl;
+			break;
 		}
+		c->meta[set_base + way] |= CACHE_META_DIRTY;
 
-		uint64_t selected_core = 0;
-		
-		if(quota_for_core0 > core0_cache_lines)
+		//Only UCP can hold the tag more than once (one copy per core)
+		way = (owner < 0) ? cache_find_way<ASSOC>(c, cache_index, cache_tag_bits, owner, way+1) : -1;
+	}
+
+	//Update appropriate stats
+	if(is_write)
+	{
+		c->stat_write_access++;
+		if(is_hit == false)
 		{
-			selected_core = core1;
 			if(VERBOSE == true)
 			{
-				std::cout << "1" << std::endl;
+				std::cout << "stat_write_miss" << c->stat_write_miss << std::endl;
 			}
+			c->stat_write_miss++;
 		}
-		if(quota_for_core0 == core0_cache_lines)
-		{
-			selected_core = core_id;
-		}
-		if (quota_for_core0 < core0_cache_lines)
+	}
+	else
+	{
+		c->stat_read_access++;
+		if(is_hit == false)
 		{
-			selected_core = core0;
 			if(VERBOSE == true)
 			{
-				std::cout << "3" << std::endl;
+				std::cout << "stat_read_miss" << c->stat_read_miss << std::endl;
 			}
+			c->stat_read_miss++;
 		}
-		if(VERBOSE == true)
-		{
-			std::cout << "selected core " << selected_core << std::endl;
-		}
+	}
 
-		//Similar implementation to the last lab for finding the oldest instruction time
-		int jj = 0;
-		while(jj<cache_ways)
-		{
-			if(c->cache_sets[set_index].cache_line[jj].valid == true)
-			{	
-				uint32_t new_insertion_time = c->cache_sets[set_index].cache_line[jj].insertion_time;
-				if(fifo_set_index == -1 || new_insertion_time < oldest_insertion_time)
-				{
-					if(c->cache_sets[set_index].cache_line[jj].core_id == selected_core)
-					{
-						oldest_insertion_time = new_insertion_time;
-						fifo_set_index = jj;
-						valid = true;
-					}
-				}
-			}
-			jj++;
-		}
-		if(valid == true)
-		{
-			if(VERBOSE == true)
+	// Return HIT if access hits in the cache, MISS otherwise 
+	return is_hit;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Oldest valid way in the set, only considering lines owned by cores with
+// eligible[core_id] set (all lines if eligible is NULL). Returns -1 if none.
+/////////////////////////////////////////////////////////////////////////////////////
+
+template<uint32_t ASSOC>
+static int cache_find_oldest_way_spec(Cache *c, uint32_t set_index, bool *eligible)
+{
+	int fifo_set_index = -1;
+	uint64_t oldest_insertion_time = -1; 
+	int cache_ways_n = cache_ways<ASSOC>(c);
+	uint64_t set_base = (uint64_t)set_index * cache_stride<ASSOC>(c);
+
+	//Similar implementation to the last lab for finding the oldest instruction time
+	for(int jj=0; jj<cache_ways_n; jj++)
+	{
+		uint32_t meta = c->meta[set_base + jj];
+		uint32_t owner = meta >> CACHE_META_OWNER_SHIFT;
+		if((meta & CACHE_META_VALID) && (eligible == NULL || (owner < c->num_cores && eligible[owner])))
+		{	
+			uint32_t new_insertion_time = c->insertion_time[set_base + jj];
+			if(fifo_set_index == -1 || new_insertion_time < oldest_insertion_time)
 			{
-				std::cout << "set" << set_index << std::endl;
-				std::cout << fifo_set_index << std::endl;
+				oldest_insertion_time = new_insertion_time;
+				fifo_set_index = jj;
 			}
-			
-			return fifo_set_index;
 		}
 	}
+	return fifo_set_index;
+}
 
-	//NEW
-	//Utility based cache partition 
-	if(c->replacement_policy == 2)
-	{
-		bool valid = false;
-		int fifo_set_index = -1;
-		uint64_t oldest_insertion_time = -1; 
-		int cache_ways = c->number_ways;
-
-		//Based on the lab description
-		uint64_t quota_for_core0 = 0;
-    	//uint64_t quote_for_core1 = 0;
-		quota_for_core0 = SWP_CORE0_WAYS; //4
-    	//quote_for_core1 = N - SWP_CORE0_WAYS;
-		uint64_t core0 = 0;
-		uint64_t core1 = 1;
-
-		//How many core 0 cache lines are there? 
-		uint64_t core0_cache_lines = 0;
-		uint64_t core1_cache_lines = 1;
-		int xx = 0;
-		while(xx<cache_ways)
-		{
-			if(c->cache_sets[set_index].cache_line[xx].core_id == 0)
-			{
-				core0_cache_lines++;
-			}
-			if(c->cache_sets[set_index].cache_line[xx].core_id == 1)
-			{
-				core1_cache_lines++;
-			}
-			xx++;
-		}
+/////////////////////////////////////////////////////////////////////////////////////
+// Way-partitioned FIFO shared by SWP, NEW and UCP: a core below its way quota
+// takes the oldest line of a core that is above its quota, otherwise it
+// replaces its own oldest line
+/////////////////////////////////////////////////////////////////////////////////////
 
-		uint64_t selected_core = 0;
-		if(quota_for_core0 == core0_cache_lines)
-		{
-			selected_core = core_id;
-		}
-		if(quota_for_core0 > core0_cache_lines)
-		{
-			selected_core = core1;
-		}
-		if(quota_for_core0 < core0_cache_lines)
+template<uint32_t ASSOC>
+static int cache_find_victim_partitioned_spec(Cache *c, uint32_t set_index, uint32_t core_id)
+{
+	int cache_ways_n = cache_ways<ASSOC>(c);
+	uint64_t set_base = (uint64_t)set_index * cache_stride<ASSOC>(c);
+	uint64_t *core_cache_lines = c->core_cache_lines;
+	bool *selected_core = c->selected_core;
+
+	//How many cache lines does each core have?
+	for(uint64_t ii=0; ii<c->num_cores; ii++)
+	{
+		core_cache_lines[ii] = 0;
+		selected_core[ii] = false;
+	}
+	for(int xx=0; xx<cache_ways_n; xx++)
+	{
+		uint32_t owner = c->meta[set_base + xx] >> CACHE_META_OWNER_SHIFT;
+		if(owner < c->num_cores)
 		{
-			selected_core = core0;
+			core_cache_lines[owner]++;
 		}
-		
+	}
 
-		//Similar implementation to the last lab for finding the oldest instruction time
-		int jj = 0;
-		while(jj<cache_ways)
+	if(core_cache_lines[core_id] < c->way_quota[core_id])
+	{
+		for(uint64_t ii=0; ii<c->num_cores; ii++)
 		{
-			if(c->cache_sets[set_index].cache_line[jj].valid == true)
-			{	
-				uint32_t new_insertion_time = c->cache_sets[set_index].cache_line[jj].insertion_time;
-				if(fifo_set_index == -1 || new_insertion_time < oldest_insertion_time)
-				{
-					if(c->cache_sets[set_index].cache_line[jj].core_id == selected_core)
-					{
-						oldest_insertion_time = new_insertion_time;
-						fifo_set_index = jj;
-						valid = true;
-					}
-				}
-			}
-			jj++;
+			selected_core[ii] = (core_cache_lines[ii] > c->way_quota[ii]);
 		}
-		if(valid == true)
+	}
+	else
+	{
+		selected_core[core_id] = true;
+	}
+
+	if(VERBOSE == true)
+	{
+		std::cout << "core cache line " << core_cache_lines[core_id] << std::endl;
+	}
+
+	return cache_find_oldest_way_spec<ASSOC>(c, set_index, selected_core);
+}
+
+template<uint32_t ASSOC, int POLICY>
+static uint32_t cache_find_victim_spec(Cache *c, uint32_t set_index, uint32_t core_id)
+{
+// see Cache_Repl in cache.h
+	uint64_t policy = cache_policy<POLICY>(c);
+
+	//There is space in the cache: invalid ways hold CACHE_INVALID_TAG
+	int invalid_way = cache_find_way<ASSOC>(c, set_index, CACHE_INVALID_TAG, -1, 0);
+	if(invalid_way >= 0)
+	{
+		return invalid_way;
+	}
+
+	//SWP, NEW and UCP partition the ways between the cores
+	if(policy == CACHE_REPL_SWP || policy == CACHE_REPL_NEW || policy == CACHE_REPL_UCP)
+	{
+		int victim = cache_find_victim_partitioned_spec<ASSOC>(c, set_index, core_id);
+		if(victim >= 0)
 		{
 			if(VERBOSE == true)
 			{
 				std::cout << "set" << set_index << std::endl;
-				std::cout << fifo_set_index << std::endl;
+				std::cout << victim << std::endl;
 			}
-			
-			return fifo_set_index;
-		} 
+			return victim;
+		}
+		//No line of the selected cores in this set: fall back to FIFO
+		int fifo_set_index = cache_find_oldest_way_spec<ASSOC>(c, set_index, NULL);
+		assert(fifo_set_index >= 0);
+		return fifo_set_index;
 	}
 
-	if(c->replacement_policy == 4)
+	uint64_t victim = cache_repl_victim<ASSOC, POLICY>(c, set_index);
+	if(VERBOSE == true)
 	{
-		bool valid = false;
-		int fifo_set_index = -1;
-		uint64_t oldest_insertion_time = -1; 
-		int cache_ways = c->number_ways;
+		std::cout << "set" << set_index << std::endl;
+		std::cout << victim << std::endl;
+	}
+	return victim;
+}
 
-		//Based on the lab description
-		uint64_t quota_for_core0 = 0;
-    	//uint64_t quote_for_core1 = 0;
-		quota_for_core0 = SWP_CORE0_WAYS; //4
-    	//quote_for_core1 = N - SWP_CORE0_WAYS;
-		uint64_t core0 = 0;
-		uint64_t core1 = 1;
 
-		//How many core 0 cache lines are there? 
-		uint64_t core0_cache_lines = 0;
-		int xx = 0;
-		while(xx<cache_ways)
-		{
-			if(c->cache_sets[set_index].cache_line[xx].core_id == 0)
-			{
-				core0_cache_lines++;
-			}
-			xx++;
-		}
+/////////////////////////////////////////////////////////////////////////////////////
+// Install the line: determine victim using replacement policy
+// Copy victim into last_evicted_line for tracking writebacks
+/////////////////////////////////////////////////////////////////////////////////////
 
-		uint64_t selected_core = 0;
-		if(quota_for_core0 == core0_cache_lines)
-		{
-			selected_core = core_id;
-		}
-		if(quota_for_core0 > core0_cache_lines)
-		{
-			selected_core = core1;
-		}
-		if(quota_for_core0 < core0_cache_lines)
-		{
-			selected_core = core0;
-		}
 
+template<uint32_t ASSOC, bool POW2, int POLICY>
+static void cache_install_spec(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id){
+
+  	// Find victim using cache_find_victim()
+	uint64_t cache_index = cache_set_index<POW2>(c, lineaddr);
+	uint64_t cache_tag_bits = cache_tag<POW2>(c, lineaddr);
+
+	uint64_t victim_way = cache_find_victim_spec<ASSOC, POLICY>(c, cache_index, core_id);
+
+	if(VERBOSE == true)
+	{
+		std::cout << "victim way" << victim_way << std::endl;
+	}
 
+	// Copy victim into last_evicted_line for tracking writebacks
+	uint64_t line = cache_index * cache_stride<ASSOC>(c) + victim_way;
+	uint32_t meta = c->meta[line];
+	Cache_Line *evicted = &c->last_evicted_line;
+	evicted->valid = (meta & CACHE_META_VALID) != 0;
+	evicted->dirty = (meta & CACHE_META_DIRTY) != 0;
+	evicted->tag = evicted->valid ? c->tags[line] : 0;
+	evicted->core_id = meta >> CACHE_META_OWNER_SHIFT;
+	evicted->insertion_time = c->insertion_time[line];
 
-		//Similar implementation to the last lab for finding the oldest instruction time
-		int jj = 0;
-		while(jj<cache_ways)
+	//Update stats
+	if (meta & CACHE_META_PREFETCH)
+	{
+		c->prefetcher->stat_useless++;
+	}
+	if (evicted->dirty == true)
+	{
+		if(VERBOSE == true)
 		{
-			if(c->cache_sets[set_index].cache_line[jj].valid == true)
-			{	
-				uint32_t new_insertion_time = c->cache_sets[set_index].cache_line[jj].insertion_time;
-				if(fifo_set_index == -1 || new_insertion_time < oldest_insertion_time)
-				{
-					if(c->cache_sets[set_index].cache_line[jj].core_id == selected_core)
-					{
-						oldest_insertion_time = new_insertion_time;
-						fifo_set_index = jj;
-						valid = true;
-					}
-				}
-			}
-			jj++;
+			std::cout << "dirty evicts" << c->stat_dirty_evicts << std::endl;
 		}
-		if(valid == true)
-		{
-			if(VERBOSE == true)
-			{
-				std::cout << "set" << set_index << std::endl;
-				std::cout << fifo_set_index << std::endl;
-			}
-			
-			return fifo_set_index;
-		} 
+		c->stat_dirty_evicts++;
 	}
+
+	//Update the other values 
+	c->tags[line] = cache_tag_bits;
+	c->meta[line] = CACHE_META_VALID | (is_write ? CACHE_META_DIRTY : 0) | (core_id << CACHE_META_OWNER_SHIFT);
+	c->insertion_time[line] = *c->clock;
+	cache_repl_on_insert<ASSOC, POLICY>(c, cache_index, victim_way);
+
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////
+// The generic path, for any geometry and policy
+/////////////////////////////////////////////////////////////////////////////////////
+
+bool cache_access_generic(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id){
+	return cache_access_spec<CACHE_ANY_ASSOC, false, CACHE_ANY_POLICY>(c, lineaddr, is_write, core_id);
+}
+
+void cache_install_generic(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id){
+	cache_install_spec<CACHE_ANY_ASSOC, false, CACHE_ANY_POLICY>(c, lineaddr, is_write, core_id);
+}
+
+uint32_t cache_find_victim(Cache *c, uint32_t set_index, uint32_t core_id){
+	return cache_find_victim_spec<CACHE_ANY_ASSOC, CACHE_ANY_POLICY>(c, set_index, core_id);
+}
+
+int cache_find_oldest_way(Cache *c, uint32_t set_index, bool *eligible){
+	return cache_find_oldest_way_spec<CACHE_ANY_ASSOC>(c, set_index, eligible);
 }
 
+int cache_find_victim_partitioned(Cache *c, uint32_t set_index, uint32_t core_id){
+	return cache_find_victim_partitioned_spec<CACHE_ANY_ASSOC>(c, set_index, core_id);
+}
 
 
+/////////////////////////////////////////////////////////////////////////////////////
+// Factory: switch the cache to the specialized access/install pair that
+// matches its associativity and policy, if its set count is a power of two.
+// Anything else keeps the generic path.
+/////////////////////////////////////////////////////////////////////////////////////
 
+template<uint32_t ASSOC, int POLICY>
+static bool cache_use_spec(Cache* c){
+	if(c->number_ways != ASSOC || c->replacement_policy != (uint64_t)POLICY)
+	{
+		return false;
+	}
+	c->access_fn  = cache_access_spec<ASSOC, true, POLICY>;
+	c->install_fn = cache_install_spec<ASSOC, true, POLICY>;
+	return true;
+}
+
+template<uint32_t ASSOC>
+static bool cache_use_spec_policies(Cache* c){
+	//UCP and CORE0 stay generic
+	return cache_use_spec<ASSOC, CACHE_REPL_FIFO>(c)  || cache_use_spec<ASSOC, CACHE_REPL_SWP>(c) ||
+	       cache_use_spec<ASSOC, CACHE_REPL_NEW>(c)   || cache_use_spec<ASSOC, CACHE_REPL_LRU>(c) ||
+	       cache_use_spec<ASSOC, CACHE_REPL_PLRU>(c)  || cache_use_spec<ASSOC, CACHE_REPL_RND>(c) ||
+	       cache_use_spec<ASSOC, CACHE_REPL_SRRIP>(c) || cache_use_spec<ASSOC, CACHE_REPL_BRRIP>(c) ||
+	       cache_use_spec<ASSOC, CACHE_REPL_DRRIP>(c);
+}
+
+bool cache_specialize(Cache* c){
+	if(!c->sets_pow2)
+	{
+		return false;
+	}
+	return cache_use_spec_policies<1>(c)  || cache_use_spec_policies<2>(c) ||
+	       cache_use_spec_policies<4>(c)  || cache_use_spec_policies<8>(c) ||
+	       cache_use_spec_policies<16>(c) || cache_use_spec_policies<32>(c);
+}
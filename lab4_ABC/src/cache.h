@@ -1,8 +1,12 @@
 #ifndef CACHE_H
 #define CACHE_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include "types.h"
+#include "sdprof.h"
+#include "prefetch.h"
+#include "mshr.h"
 
 
 /////////////////////////////////////////////////////////////////////////////////////////////
@@ -11,21 +15,30 @@
 
 //Define the variables
 typedef struct Cache_Line Cache_Line;
-typedef struct Cache_Set Cache_Set;
 typedef struct Cache Cache;
 
+typedef bool (*Cache_Access_Fn)(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id);
+typedef void (*Cache_Install_Fn)(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id);
+
 typedef struct Utility_Monitor_Struct Utility_Monitor_Struct;
 typedef struct Temporary_Cache Temporary_Cache;
 
 
+/*
+UCP utility monitor (UMON) of one core: shadow tags of a sample of the
+cache's sets, as if the core had the whole cache to itself. A hit at LRU
+stack position p means the core would have hit with p+1 or more ways, so
+counter[p] is the extra hits the (p+1)-th way is worth.
+*/
 struct Utility_Monitor_Struct
 {
   uint64_t number_ways;
   uint64_t replacement_policy;
-  uint64_t number_sets;
+  uint64_t number_sets; //sampled sets
+  uint64_t sample_period; //set s of the cache is sampled if s % sample_period == 0
 
-  Cache *Auxiliary_Tag_Directory;
-  uint64_t *counter;
+  Cache *Auxiliary_Tag_Directory; //number_sets sets, true LRU
+  uint64_t *counter; //hits at each LRU stack position
 };
 
 struct Temporary_Cache{
@@ -57,16 +70,63 @@ struct Cache_Line {
 };
 
 /*
-“Cache Set” structure (Cache_Set), will have:
-●Cache_Line Struct (replicated “# of Ways” times, as in an array/list)
+The tag store keeps the Cache_Line fields as separate arrays (structure of
+arrays), set after set: way w of set s is entry s*way_stride + w. The tags
+of a set are contiguous and aligned, so cache_access() compares
+CACHE_TAG_VECTOR of them at a time (SSE2, or AVX2 when built with
+make ARCH=-mavx2). way_stride is number_ways rounded up to CACHE_TAG_VECTOR; the
+padding ways hold CACHE_INVALID_TAG like invalid lines, so they never match.
+Valid, dirty, prefetched and owner core are packed into one meta word per line.
+Cache_Line is only used to hand the last evicted line to the caller.
+
+cache_access() and cache_install() call through access_fn/install_fn.
+cache_new() points them at the generic code; cache_specialize() switches a
+cache with a power-of-two set count and a common associativity and policy
+to code compiled for exactly that configuration (see cache.cpp).
 */
 
-struct Cache_Set {
-    //Takes the number of ways as an array or list 
-    //We know the number of ways is 16 
-    //Need to use the cache line struct 
-    Cache_Line cache_line[16];
-};
+#define CACHE_TAG_VECTOR        4
+#define CACHE_INVALID_TAG       (~(Addr)0)
+
+#define CACHE_META_VALID        0x1
+#define CACHE_META_DIRTY        0x2
+#define CACHE_META_PREFETCH     0x4     // filled by the prefetcher, no demand access yet
+#define CACHE_META_OWNER_SHIFT  3
+
+/*
+Replacement policies. The numbers of the original policies are kept, so
+existing scripts still select the same ones. Each policy keeps its own
+per-line state in repl_state (same layout as tags) and is driven by three
+hooks in cache.cpp: on a hit, on an insert, and to pick a victim among
+the valid ways of a full set.
+LRU: repl_state is the recency rank of the way, 0 = MRU
+PLRU: tree pseudo-LRU, one bit per tree node in plru_bits (one word per set)
+RND: uniform over the ways, from a seeded xorshift generator
+SRRIP/BRRIP: repl_state is the 2-bit re-reference prediction value (RRPV)
+DRRIP: CACHE_DUEL_SETS leader sets each for SRRIP and BRRIP; the policy
+that misses less in its leaders (psel) is used by all other sets
+SWP, NEW and UCP partition the ways and replace FIFO within a partition.
+*/
+typedef enum Cache_Repl_Enum {
+    CACHE_REPL_FIFO=0,
+    CACHE_REPL_SWP=1,
+    CACHE_REPL_NEW=2,
+    CACHE_REPL_UCP=4,
+    CACHE_REPL_CORE0=5,   // FIFO, but only lines installed by core 0 hit
+    CACHE_REPL_LRU=6,
+    CACHE_REPL_PLRU=7,
+    CACHE_REPL_RND=8,
+    CACHE_REPL_SRRIP=9,
+    CACHE_REPL_BRRIP=10,
+    CACHE_REPL_DRRIP=11,
+    NUM_CACHE_REPL
+} Cache_Repl;
+
+#define CACHE_RRPV_MAX          3       // 2-bit RRPV: 3 = distant re-reference
+#define CACHE_BRRIP_LONG_ODDS   32      // BRRIP inserts at RRPV_MAX-1 once in this many
+#define CACHE_DUEL_SETS         32      // DRRIP: one SRRIP and one BRRIP leader every this many sets
+#define CACHE_PSEL_MAX          1023    // DRRIP: 10-bit policy selector
+#define CACHE_UMON_SETS         32      // UCP: sets sampled by each utility monitor
 
 /*
 The overarching “Cache” structure should have:
@@ -87,11 +147,23 @@ cache
 */
 
 struct Cache{
-    Cache_Set *cache_sets; //Cache_set Struct
+    Addr *tags; //tag of every way, CACHE_INVALID_TAG if the way is invalid
+    uint32_t *meta; //valid, dirty and owner core of every way (CACHE_META_*)
+    uint32_t *insertion_time; //to keep track of when each line was inserted
+    uint64_t way_stride; //entries per set in the arrays above
     uint64_t number_ways; //number of ways 
     //uint64_t replacement_policy //Needs to follow the variable name 
     uint64_t replacement_policy; //Replacement policy
     uint64_t number_sets; //number of sets
+    bool sets_pow2; //number_sets is a power of two: index is lineaddr & set_mask, tag is lineaddr >> set_shift
+    uint64_t set_mask;
+    uint64_t set_shift;
+    Cache_Access_Fn access_fn; //cache_access_generic() or a specialization
+    Cache_Install_Fn install_fn; //cache_install_generic() or a specialization
+    uint8_t *repl_state; //per-line replacement state (LRU rank, RRPV), see Cache_Repl
+    uint64_t *plru_bits; //PLRU: tree bits of every set
+    uint64_t repl_rng; //RND, BRRIP and DRRIP: xorshift state
+    uint64_t repl_psel; //DRRIP: below CACHE_PSEL_MAX/2+1 the follower sets use SRRIP
     Cache_Line last_evicted_line; //Last evicted Line (Cache_Line type) to be passed on to next higher cache hierarchy for an install if necessary
 
     uint64_t stat_read_access; //Number of read (lookup accesses do not count as READ accesses accesses made to the cache
@@ -99,7 +171,34 @@ struct Cache{
     uint64_t stat_read_miss; //Number of READ requests that lead to a MISS at the respective cache
     uint64_t stat_write_miss; //Number of WRITE requests that lead to a MISS at the respective cache
     uint64_t stat_dirty_evicts; //Count of requests to evict DIRTY lines  
-    Utility_Monitor_Struct *utility_monitor_struct[2];
+
+    uint64_t num_cores; //number of cores sharing the cache
+    uint64_t *way_quota; //per-core way quota for the partitioned policies (SWP, NEW, UCP)
+    uint64_t *core_cache_lines; //scratch for cache_find_victim_partitioned()
+    bool *selected_core; //scratch for cache_find_victim_partitioned()
+    Utility_Monitor_Struct **utility_monitor_struct; //one per core
+    uint64_t ucp_epoch_cycles; //UCP: repartition every this many cycles, 0: never
+    uint64_t ucp_next_epoch; //cycle of the next repartition
+    uint64_t ucp_epochs; //repartitions so far
+    uint64_t *ucp_log; //way quota of every core after every repartition
+    uint64_t *ucp_log_cycle; //cycle of every repartition
+    uint64_t ucp_log_size; //entries allocated in ucp_log_cycle
+
+    const uint64_t *clock; //cycle counter of the simulation that owns this cache
+    Sdprof *sdprof; //stack-distance profile of the access stream (-sdprof), else NULL
+
+    Prefetcher *prefetcher; //trained by memsys on demand accesses, else NULL
+    uint64_t *prefetch_ready; //with a prefetcher: cycle the fill of each prefetched line completes
+    bool last_hit_prefetch; //the last cache_access() was the first use of a prefetched line
+    uint64_t last_hit_ready; //cycle that line's fill completes, see cache_prefetch_hit()
+
+    Mshr *mshr; //fills in flight, taken and checked by memsys, else NULL (see mshr.h)
+
+    uint64_t stat_back_invals; //inclusive: copies its evictions removed from the caches above it
+    uint64_t stat_back_invals_dirty; //... that were dirty, and made the victim dirty
+    uint64_t stat_inclusion_victims; //lines an inclusive cache below removed from this one
+    uint64_t stat_writes_down; //write-through or no-write-allocate: writes passed on to the level below
+    uint64_t *stat_set_misses; //with the layout stats (-page_sizeKB, -huge_pages): demand misses of every set, else NULL
 };
 /////////////////////////////////////////////////////////////////////////////////////////////
 // Mandatory variables required for generating the desired final reports as necessary
@@ -117,17 +216,46 @@ struct Cache{
 // Functions to be implemented
 /////////////////////////////////////////////////////////////////////////////////////////////
 
-Cache* cache_new(uint64_t size, uint64_t assocs, uint64_t linesize, uint64_t repl_policy);
-bool cache_access(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id);
-void cache_install(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id);
+Cache* cache_new(uint64_t size, uint64_t assocs, uint64_t linesize, uint64_t repl_policy, uint64_t num_cores, const uint64_t* clock);
+void cache_free(Cache* c);
+bool cache_access_generic(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id);
+void cache_install_generic(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id);
+bool cache_specialize(Cache* c);
+void cache_seed(Cache* c, uint64_t seed);
+void cache_set_prefetcher(Cache* c, Prefetcher* pf);
+bool cache_probe(Cache* c, Addr lineaddr, uint32_t core_id);
+void cache_mark_prefetch(Cache* c, Addr lineaddr, uint32_t core_id, uint64_t ready_cycle);
+uint64_t cache_prefetch_hit(Cache* c, uint64_t cycle);
+uint32_t cache_invalidate(Cache* c, Addr lineaddr);
+void cache_clean(Cache* c, Addr lineaddr);
+uint64_t cache_valid_lines(Cache* c, Addr* lineaddrs);
+uint64_t cache_repl_parse(const char* s);
 uint32_t cache_find_victim(Cache* c, uint32_t set_index, uint32_t core_id);
+int cache_find_oldest_way(Cache* c, uint32_t set_index, bool* eligible);
+int cache_find_victim_partitioned(Cache* c, uint32_t set_index, uint32_t core_id);
+void cache_set_core0_quota(Cache* c, uint64_t core0_ways);
+void cache_set_quotas(Cache* c, uint64_t core0_ways, uint64_t* quotas);
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////
 
-void cache_print_stats(Cache* c, char* header);
+void cache_print_stats(Cache* c, char* header, FILE* out);
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Return HIT if access hits in the cache, MISS otherwise
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline bool cache_access(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id){
+    return c->access_fn(c, lineaddr, is_write, core_id);
+}
+
+static inline void cache_install(Cache* c, Addr lineaddr, uint32_t is_write, uint32_t core_id){
+    c->install_fn(c, lineaddr, is_write, core_id);
+}
 
-Utility_Monitor_Struct* utility_monitor_struct_new(uint64_t size, uint64_t assocs, uint64_t linesize, uint64_t repl_policy);
+Utility_Monitor_Struct* utility_monitor_struct_new(uint64_t cache_sets, uint64_t assocs, uint64_t linesize);
+void cache_ucp_repartition(Cache* c);
+void cache_print_ucp_stats(Cache* c, char* header, FILE* out);
 Temporary_Cache* temporary_cache_new(uint64_t size, uint64_t assocs, uint64_t linesize, uint64_t repl_policy);
 
 #endif // CACHE_H
@@ -6,38 +6,180 @@
 #include <math.h>
 
 #include "core.h"
-
-extern uint64_t cycle;
+#include "hostprof.h"
 
 extern void die_message(const char* msg);
 
 
 ////////////////////////////////////////////////////////////////////
+// The trace is opened (and positioned) by the caller, see sim_new()
 ////////////////////////////////////////////////////////////////////
 
-Core* core_new(Memsys* memsys, char* trace_fname, uint32_t core_id){
+Core* core_new(Memsys* memsys, Trace* trace, uint32_t core_id, const uint64_t* clock){
 	Core* c = (Core*)calloc(1, sizeof(Core));
 	c->core_id = core_id;
 	c->memsys  = memsys;
+	c->clock   = clock;
+
+	Sim_Config* cfg = memsys->cfg;
+	if (cfg->core_ooo) {
+		if (cfg->rob_size == 0 || cfg->issue_width == 0 || cfg->retire_width == 0) {
+			die_message("The ROB and the issue and retire widths need at least one entry");
+		}
+		c->rob          = (Core_Rob_Entry*)calloc(cfg->rob_size, sizeof(Core_Rob_Entry));
+		c->rob_size     = cfg->rob_size;
+		c->issue_width  = cfg->issue_width;
+		c->retire_width = cfg->retire_width;
+	}
+	if (cfg->store_buffer_entries) {
+		c->sb_done = (uint64_t*)calloc(cfg->store_buffer_entries, sizeof(uint64_t));
+		c->sb_size = cfg->store_buffer_entries;
+	}
 
-	strcpy(c->trace_fname, trace_fname);
-	core_init_trace(c);
+	strcpy(c->trace_fname, trace->fname);
+	c->trace = trace;
 	core_read_trace(c);
 
 	return c;
 }
 
+// The trace is closed by core_print_stats()
+void core_free(Core* c){
+	free(c->rob);
+	free(c->sb_done);
+	free(c);
+}
+
+////////////////////////////////////////////////////////////////////
+// Cycles a store at cycle has to wait for room in the store buffer
+////////////////////////////////////////////////////////////////////
+
+static uint64_t core_sb_wait(Core* c, uint64_t cycle){
+	while (c->sb_count && c->sb_done[c->sb_head] <= cycle) {
+		c->sb_head = (c->sb_head + 1) % c->sb_size;
+		c->sb_count--;
+	}
+	if (c->sb_count < c->sb_size) {
+		return 0;
+	}
+	return c->sb_done[c->sb_head] - cycle;
+}
+
+////////////////////////////////////////////////////////////////////
+// The store enters the buffer at cycle (there is room, see
+// core_sb_wait()) and drains after the stores ahead of it
+////////////////////////////////////////////////////////////////////
+
+static void core_sb_store(Core* c, uint64_t cycle){
+	assert(c->sb_count < c->sb_size);
+	uint64_t delay = memsys_access(c->memsys, c->trace_ldst_addr, c->trace_inst_addr, ACCESS_TYPE_STORE, c->core_id);
+	uint64_t start = (c->sb_drain_cycle > cycle) ? c->sb_drain_cycle : cycle;
+	c->sb_drain_cycle = start + delay;
+
+	c->sb_done[(c->sb_head + c->sb_count) % c->sb_size] = c->sb_drain_cycle;
+	c->sb_count++;
+	c->stat_sb_stores++;
+	c->stat_sb_occupancy += c->sb_count;
+}
+
+// inst_count and done are read by print_progress() while a -parallel
+// core thread runs: the core's own thread stores them atomically
+static void core_finish(Core* c){
+	__atomic_store_n(&c->done, true, __ATOMIC_RELAXED);
+	c->done_inst_count  = c->inst_count;
+	c->done_cycle_count = *c->clock;
+}
+
+////////////////////////////////////////////////////////////////////
+// Charge n cycles up to cycle to the stall reasons, after the core
+// retired and dispatched that many instructions in each (see core.h)
+////////////////////////////////////////////////////////////////////
+
+static void core_ooo_stalls(Core* c, uint64_t cycle, uint64_t retired, uint64_t dispatched, uint64_t n){
+	Core_Rob_Entry* head = &c->rob[c->rob_head];
+
+	c->stat_rob_occupancy += c->rob_count * n;
+	if (!retired && c->rob_count && head->is_load && head->done_cycle > cycle) {
+		c->stat_load_head_cycles += n;
+	}
+	if (!c->trace_done && c->rob_count == c->rob_size && dispatched < c->issue_width) {
+		c->stat_rob_full_cycles += n;
+	}
+	if (!dispatched && !c->trace_done && c->rob_count < c->rob_size && c->fetch_resume_cycle > cycle) {
+		c->stat_fetch_starved_cycles += n;
+	}
+	if (!dispatched && !c->trace_done && c->rob_count < c->rob_size && c->store_resume_cycle > cycle) {
+		c->stat_sb_full_cycles += n;
+	}
+}
+
 ////////////////////////////////////////////////////////////////////
+// Out-of-order core: retire the completed instructions at the head of
+// the ROB, then dispatch new ones behind them
 ////////////////////////////////////////////////////////////////////
 
-void core_init_trace(Core* c){
-	char command_string[512];
-	sprintf(command_string,"gunzip -c %s", c->trace_fname);
-	if ((c->trace = popen(command_string, "r")) == NULL) {
-		printf("Command string is %s\n", command_string);
-		die_message("Unable to open the file with gzip option\n");
+static void core_cycle_ooo(Core* c){
+	uint64_t cycle = *c->clock;
+
+	// cycles skipped since the last call (see core_next_active_cycle())
+	// neither retired nor dispatched anything
+	if (cycle > c->last_cycle + 1) {
+		core_ooo_stalls(c, cycle-1, 0, 0, cycle - c->last_cycle - 1);
+	}
+	c->last_cycle = cycle;
+
+	uint64_t retired = 0;
+	while (retired < c->retire_width && c->rob_count && c->rob[c->rob_head].done_cycle <= cycle) {
+		c->rob_head = (c->rob_head + 1) % c->rob_size;
+		c->rob_count--;
+		retired++;
+	}
+	__atomic_store_n(&c->inst_count, c->inst_count + retired, __ATOMIC_RELAXED);
+
+	uint64_t dispatched = 0;
+	while (dispatched < c->issue_width && !c->trace_done && c->rob_count < c->rob_size &&
+	       cycle >= c->fetch_resume_cycle && cycle >= c->store_resume_cycle) {
+		if (c->trace_inst_type == INST_TYPE_STORE && c->sb_done) {
+			uint64_t sb_wait = core_sb_wait(c, cycle);
+			if (sb_wait) {
+				c->store_resume_cycle = cycle + sb_wait;
+				break;
+			}
+		}
+		uint64_t ifetch_delay = memsys_access(c->memsys, c->trace_inst_addr, c->trace_inst_addr, ACCESS_TYPE_IFETCH, c->core_id);
+		uint64_t fetched = cycle + ((ifetch_delay > 1) ? ifetch_delay-1 : 0);
+
+		Core_Rob_Entry* e = &c->rob[(c->rob_head + c->rob_count) % c->rob_size];
+		e->is_load = (c->trace_inst_type == INST_TYPE_LOAD);
+		e->done_cycle = fetched + 1;
+		if (c->trace_inst_type == INST_TYPE_LOAD) {
+			uint64_t ld_delay = memsys_access(c->memsys, c->trace_ldst_addr, c->trace_inst_addr, ACCESS_TYPE_LOAD, c->core_id);
+			if (ld_delay > 1) {
+				e->done_cycle = fetched + ld_delay;
+			}
+		}
+		if (c->trace_inst_type == INST_TYPE_STORE) {
+			if (c->sb_done) {
+				core_sb_store(c, cycle);
+			} else {
+				memsys_access(c->memsys, c->trace_ldst_addr, c->trace_inst_addr, ACCESS_TYPE_STORE, c->core_id);
+			}
+		}
+		c->rob_count++;
+		dispatched++;
+
+		core_read_trace(c);
+		if (ifetch_delay > 1) {
+			c->fetch_resume_cycle = cycle + ifetch_delay;
+			break;
+		}
 	}
 
+	core_ooo_stalls(c, cycle, retired, dispatched, 1);
+
+	if (c->trace_done && c->rob_count == 0) {
+		core_finish(c);
+	}
 }
 
 ////////////////////////////////////////////////////////////////////
@@ -47,32 +189,46 @@ void core_cycle(Core* c){
 	if (c->done) {
 		return;
 	}
+	if (c->rob) {
+		core_cycle_ooo(c);
+		return;
+	}
+
+	uint64_t cycle = *c->clock;
 
 	// if core is snoozing on DRAM hits, return ..
 	if (cycle <= c->snooze_end_cycle) {
 		return;
 	}
 
-	c->inst_count++;
+	__atomic_store_n(&c->inst_count, c->inst_count + 1, __ATOMIC_RELAXED);
 
 	uint32_t ifetch_delay=0, ld_delay=0, bubble_cycles=0;
 
-	ifetch_delay = memsys_access(c->memsys, c->trace_inst_addr, ACCESS_TYPE_IFETCH, c->core_id);
+	ifetch_delay = memsys_access(c->memsys, c->trace_inst_addr, c->trace_inst_addr, ACCESS_TYPE_IFETCH, c->core_id);
 	if (ifetch_delay > 1) {
 		bubble_cycles += (ifetch_delay-1);
 	}
 
 	if (c->trace_inst_type == INST_TYPE_LOAD) {
-		ld_delay = memsys_access(c->memsys, c->trace_ldst_addr, ACCESS_TYPE_LOAD, c->core_id);
+		ld_delay = memsys_access(c->memsys, c->trace_ldst_addr, c->trace_inst_addr, ACCESS_TYPE_LOAD, c->core_id);
 	}
 	if (ld_delay > 1) {
 		bubble_cycles += (ld_delay-1);
 	}
 
-	if (c->trace_inst_type == INST_TYPE_STORE){
-		memsys_access(c->memsys, c->trace_ldst_addr, ACCESS_TYPE_STORE, c->core_id);
+	if (c->trace_inst_type == INST_TYPE_STORE && c->sb_done) {
+		uint64_t sb_wait = core_sb_wait(c, cycle);
+		c->stat_sb_full_cycles += sb_wait;
+		bubble_cycles += sb_wait;
+		// the stores that drained while it waited leave the buffer
+		core_sb_wait(c, cycle + sb_wait);
+		core_sb_store(c, cycle + sb_wait);
+	}
+	else if (c->trace_inst_type == INST_TYPE_STORE){
+		memsys_access(c->memsys, c->trace_ldst_addr, c->trace_inst_addr, ACCESS_TYPE_STORE, c->core_id);
 	}
-	//No bubbles for store misses
+	//No bubbles for store misses, unless the store buffer is full
 
 	if (bubble_cycles) {
 		c->snooze_end_cycle = (cycle+bubble_cycles);
@@ -81,37 +237,80 @@ void core_cycle(Core* c){
 	core_read_trace(c);
 }
 
+////////////////////////////////////////////////////////////////////
+// Earliest cycle at which core_cycle() can do anything for this core;
+// every cycle before it is a no-op (used to skip idle cycles)
+////////////////////////////////////////////////////////////////////
+
+uint64_t core_next_active_cycle(Core* c){
+	if (c->done) {
+		return UINT64_MAX;
+	}
+	if (c->rob) {
+		uint64_t next = UINT64_MAX;
+		if (c->rob_count) {
+			next = c->rob[c->rob_head].done_cycle;
+		}
+		uint64_t resume = (c->fetch_resume_cycle > c->store_resume_cycle) ? c->fetch_resume_cycle : c->store_resume_cycle;
+		if (!c->trace_done && c->rob_count < c->rob_size && resume < next) {
+			next = resume;
+		}
+		return next;
+	}
+	return c->snooze_end_cycle + 1;
+}
+
 ////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////
 
 void core_read_trace (Core* c){
-	uint32_t tmp;
-	tmp = fread (&c->trace_inst_addr, 4, 1, c->trace);
-	tmp = fread (&c->trace_inst_type, 1, 1, c->trace);
-	tmp = fread (&c->trace_ldst_addr, 4, 1, c->trace);
+	Trace_Record rec;
+
+	HOSTPROF_START(host_start);
+	bool more = trace_read(c->trace, &rec);
+	HOSTPROF_ADD(c->stat_trace_ns, host_start);
 
-	if (feof(c->trace)) {
-		c->done = true;
-		c->done_inst_count  = c->inst_count;
-		c->done_cycle_count = cycle;
+	if (!more) {
+		// the out-of-order core still has to drain its ROB
+		c->trace_done = true;
+		if (c->rob_count == 0) {
+			core_finish(c);
+		}
+		return;
 	}
 
+	c->trace_inst_addr = rec.inst_addr;
+	c->trace_inst_type = rec.inst_type;
+	c->trace_ldst_addr = rec.ldst_addr;
 }
 
 ////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////
 
-void core_print_stats(Core* c){
+void core_print_stats(Core* c, FILE* out){
 	char header[256];
 	double ipc = (double)(c->done_inst_count) / (double)(c->done_cycle_count);
 	sprintf(header, "CORE_%01d", c->core_id);
 
-	printf("\n");
-	printf("\n%s_INST         \t\t : %10llu", header,  c->done_inst_count);
-	printf("\n%s_CYCLES       \t\t : %10llu", header,  c->done_cycle_count);
-	printf("\n%s_IPC          \t\t : %10.3f", header,  ipc);
+	fprintf(out, "\n");
+	fprintf(out, "\n%s_INST         \t\t : %10llu", header,  c->done_inst_count);
+	fprintf(out, "\n%s_CYCLES       \t\t : %10llu", header,  c->done_cycle_count);
+	fprintf(out, "\n%s_IPC          \t\t : %10.3f", header,  ipc);
+	if (c->rob) {
+		double rob_occupancy = (double)(c->stat_rob_occupancy) / (double)(c->done_cycle_count);
+		fprintf(out, "\n%s_ROB_FULL_CYCLES\t\t : %10llu", header, (unsigned long long)c->stat_rob_full_cycles);
+		fprintf(out, "\n%s_LOAD_HEAD_CYCLES\t\t : %10llu", header, (unsigned long long)c->stat_load_head_cycles);
+		fprintf(out, "\n%s_FETCH_STARVED_CYCLES\t : %10llu", header, (unsigned long long)c->stat_fetch_starved_cycles);
+		fprintf(out, "\n%s_ROB_AVG_OCCUPANCY\t : %10.3f", header, rob_occupancy);
+	}
+	if (c->sb_done) {
+		double sb_occupancy = c->stat_sb_stores ? (double)(c->stat_sb_occupancy) / (double)(c->stat_sb_stores) : 0;
+		fprintf(out, "\n%s_SB_FULL_CYCLES \t\t : %10llu", header, (unsigned long long)c->stat_sb_full_cycles);
+		fprintf(out, "\n%s_SB_AVG_OCCUPANCY\t\t : %10.3f", header, sb_occupancy);
+	}
+	trace_print_stats(c->trace, header, out);
 
-	pclose(c->trace);
+	trace_close(c->trace);
 }
 
 
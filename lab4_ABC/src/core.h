@@ -1,26 +1,53 @@
 #ifndef CORE_H
 #define CORE_H
 
+#include <stdio.h>
 #include <stdint.h>
 
 #include "types.h"
 #include "memsys.h"
+#include "trace.h"
 
 typedef struct Core Core;
+typedef struct Core_Rob_Entry Core_Rob_Entry;
 
 
 
 ////////////////////////////////////////////////////////////////////////////
+// Two timing models. The default in-order core executes one instruction
+// per cycle and sleeps through the delay of every instruction fetch and
+// load miss (snooze_end_cycle), so misses never overlap.
+//
+// The out-of-order core (-ooo 1) dispatches up to issue_width
+// instructions per cycle into a ROB of rob_size entries and retires up
+// to retire_width per cycle in order, once they complete. The trace has
+// no register dependencies, so a load issues to the memory system as it
+// dispatches, under any misses still outstanding, and completes after
+// its delay; other instructions complete the next cycle. An instruction
+// fetch that misses holds up dispatch until the line arrives. Cycles
+// are charged to three (overlapping) stall reasons: the ROB was full,
+// nothing retired because the load at the head was waiting for its data,
+// and nothing dispatched because fetch was waiting.
+//
+// Either core can have a store buffer (-store_buffer). A store takes an
+// entry and drains to the L1 dcache in the background, in order, one
+// at a time, for as long as its access takes; the core only stalls
+// when a store finds the buffer full. Without one stores cost nothing.
 ////////////////////////////////////////////////////////////////////////////
 
+struct Core_Rob_Entry {
+  uint64_t done_cycle;       // cycle it can retire from
+  bool     is_load;
+};
 
 struct Core {
   uint32_t core_id;
 
   Memsys* memsys;
+  const uint64_t* clock;  // cycle counter of the owning simulation
     
   char trace_fname[1024];
-  FILE* trace;
+  Trace* trace;
     
   uint32_t done;
 
@@ -29,10 +56,39 @@ struct Core {
   uint64_t trace_ldst_addr;
   
   uint64_t snooze_end_cycle; // when waiting for data to return
+  bool     trace_done;       // the last instruction has been read
+
+  // out-of-order core, rob is NULL for the in-order one
+  Core_Rob_Entry* rob;
+  uint64_t rob_size;
+  uint64_t rob_head;
+  uint64_t rob_count;
+  uint64_t issue_width;
+  uint64_t retire_width;
+  uint64_t fetch_resume_cycle; // dispatch waits for an instruction fetch until then
+  uint64_t store_resume_cycle; // ... or for room in the store buffer
+  uint64_t last_cycle;         // last cycle core_cycle() ran, to charge the skipped ones
+
+  // store buffer, sb_done is NULL without one
+  uint64_t* sb_done;           // per entry, cycle its store has drained
+  uint64_t sb_size;
+  uint64_t sb_head;
+  uint64_t sb_count;
+  uint64_t sb_drain_cycle;     // cycle the youngest store will have drained
 
   unsigned long long inst_count;
   unsigned long long done_inst_count;
   unsigned long long done_cycle_count;
+
+  uint64_t stat_trace_ns;    // host time reading the trace, HOST_PROFILE builds only
+
+  uint64_t stat_rob_full_cycles;      // out-of-order: dispatch stopped by a full ROB
+  uint64_t stat_load_head_cycles;     // nothing retired, a load at the head waiting for data
+  uint64_t stat_fetch_starved_cycles; // nothing dispatched, fetch waiting on a miss
+  uint64_t stat_rob_occupancy;        // ROB entries in use, summed over the cycles
+  uint64_t stat_sb_full_cycles;       // stalled for room in the store buffer
+  uint64_t stat_sb_occupancy;         // store buffer entries in use at each store, summed
+  uint64_t stat_sb_stores;
 };
 
 
@@ -40,11 +96,12 @@ struct Core {
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 
-Core* core_new(Memsys* memsys, char* trace_fname, uint32_t core_id);
+Core* core_new(Memsys* memsys, Trace* trace, uint32_t core_id, const uint64_t* clock);
+void core_free(Core* c);
 void core_cycle(Core* core);
-void core_print_stats(Core* c);
+uint64_t core_next_active_cycle(Core* c);
+void core_print_stats(Core* c, FILE* out);
 void core_read_trace(Core* c);
-void core_init_trace(Core* c);
 
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -4,16 +4,13 @@
 #include <iostream>
 
 #include "dram.h"
+#include "hostprof.h"
 
-// As part of the lab description
-extern MODE SIM_MODE;
-extern uint64_t  CACHE_LINESIZE;
-extern bool DRAM_PAGE_POLICY;
 ////////////////////////////////////////////////////////////////////
 // ------------- DO NOT MODIFY THE PRINT STATS FUNCTION ------------
 ////////////////////////////////////////////////////////////////////
 
-void dram_print_stats(DRAM* dram){
+void dram_print_stats(DRAM* dram, FILE* out){
 	double rddelay_avg=0, wrdelay_avg=0;
 	char header[256];
 	sprintf(header, "DRAM");
@@ -26,19 +23,37 @@ void dram_print_stats(DRAM* dram){
 		wrdelay_avg = (double)(dram->stat_write_delay) / (double)(dram->stat_write_access);
 	}
 
-	printf("\n%s_READ_ACCESS\t\t : %10llu", header, dram->stat_read_access);
-	printf("\n%s_WRITE_ACCESS\t\t : %10llu", header, dram->stat_write_access);
-	printf("\n%s_READ_DELAY_AVG\t\t : %10.3f", header, rddelay_avg);
-	printf("\n%s_WRITE_DELAY_AVG\t\t : %10.3f", header, wrdelay_avg);
+	fprintf(out, "\n%s_READ_ACCESS\t\t : %10llu", header, dram->stat_read_access);
+	fprintf(out, "\n%s_WRITE_ACCESS\t\t : %10llu", header, dram->stat_write_access);
+	fprintf(out, "\n%s_READ_DELAY_AVG\t\t : %10.3f", header, rddelay_avg);
+	fprintf(out, "\n%s_WRITE_DELAY_AVG\t\t : %10.3f", header, wrdelay_avg);
 
 }
 
+////////////////////////////////////////////////////////////////////
+// Row buffer locality, printed with the layout stats (-page_sizeKB,
+// -huge_pages) to compare page sizes
+////////////////////////////////////////////////////////////////////
+
+void dram_print_rowbuf_stats(DRAM* dram, FILE* out){
+	uint64_t accesses = dram->stat_rowbuf_hit + dram->stat_rowbuf_miss;
+	double hit_perc = 0;
+	if (accesses) {
+		hit_perc = 100.0 * (double)dram->stat_rowbuf_hit / (double)accesses;
+	}
+
+	fprintf(out, "\nDRAM_ROWBUF_HIT\t\t : %10llu", (unsigned long long)dram->stat_rowbuf_hit);
+	fprintf(out, "\nDRAM_ROWBUF_MISS\t\t : %10llu", (unsigned long long)dram->stat_rowbuf_miss);
+	fprintf(out, "\nDRAM_ROWBUF_HIT_PERC\t\t : %10.3f", hit_perc);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // Allocate memory to the data structures and initialize the required fields
 //////////////////////////////////////////////////////////////////////////////
 
-DRAM* dram_new() {
-	DRAM *dram = (DRAM *) malloc (1 * sizeof (DRAM));
+DRAM* dram_new(Sim_Config* cfg) {
+	DRAM *dram = (DRAM *) calloc (1, sizeof (DRAM));
+	dram->cfg = cfg;
 	return dram;
 }
 
@@ -47,9 +62,10 @@ DRAM* dram_new() {
 //////////////////////////////////////////////////////////////////////////////
 
 uint64_t dram_access(DRAM* dram, Addr lineaddr, bool is_dram_write) {
+	HOSTPROF_START(host_start);
 	uint64_t fixed_dram_delay = 100;
 
-	if((SIM_MODE == SIM_MODE_C) | (SIM_MODE == SIM_MODE_D) | (SIM_MODE == SIM_MODE_E))
+	if((dram->cfg->sim_mode == SIM_MODE_C) | (dram->cfg->sim_mode == SIM_MODE_D) | (dram->cfg->sim_mode == SIM_MODE_E))
 	{
 		fixed_dram_delay = dram_access_mode_CDE(dram, lineaddr, is_dram_write);
 	}
@@ -67,7 +83,7 @@ uint64_t dram_access(DRAM* dram, Addr lineaddr, bool is_dram_write) {
 		//std::cout << "dram read_access " << dram->stat_read_access << std::endl;
 	}
 	
-  
+  	HOSTPROF_ADD(dram->stat_host_ns, host_start);
   	return fixed_dram_delay;
 }
 
@@ -99,7 +115,7 @@ uint64_t dram_access_mode_CDE(DRAM* dram, Addr lineaddr, bool is_dram_write) {
 	*/
 	uint64_t dram_access_delay = 0;
 	uint64_t dram_banks = 16;
-	uint64_t cache_linesize = CACHE_LINESIZE;
+	uint64_t cache_linesize = dram->cfg->cache_linesize;
 	uint64_t row_buffer_size = 1024;
 	uint64_t act = 45;
 	uint64_t cas = 45; //Column Address Strobe
@@ -109,13 +125,14 @@ uint64_t dram_access_mode_CDE(DRAM* dram, Addr lineaddr, bool is_dram_write) {
 	uint64_t bank_id = lineaddr % dram_banks; 
 	uint64_t row_id = (lineaddr / row_buffer_lines) / dram_banks;
 
-	if(DRAM_PAGE_POLICY == false)
+	if(dram->cfg->dram_page_policy == false)
 	{
 		//Row buffer is not valid 
 		//RAS + CAS if array precharged OR
 		if (dram->array[bank_id].valid == false)
 		{
 			dram_access_delay = act + cas + bus;
+			dram->stat_rowbuf_miss++;
 			dram->array[bank_id].valid = true;
 			dram->array[bank_id].row_id = row_id;
 		}
@@ -125,27 +142,31 @@ uint64_t dram_access_mode_CDE(DRAM* dram, Addr lineaddr, bool is_dram_write) {
 		else if ((dram->array[bank_id].valid == true) && (dram->array[bank_id].row_id == row_id))
 		{
 			dram_access_delay = cas + bus;
+			dram->stat_rowbuf_hit++;
 		}
 		//PRE + RAS + CAS (worst case)
 		else 
 		{
 			dram_access_delay = pre + act + cas + bus;
+			dram->stat_rowbuf_miss++;
 			dram->array[bank_id].valid = true;
 			dram->array[bank_id].row_id = row_id;
 		}
 	}
-	if(DRAM_PAGE_POLICY == true)
+	if(dram->cfg->dram_page_policy == true)
 	{
 		//Row is valid and the id matches 
 		//Row buffer hit 
 		if ((dram->array[bank_id].valid == true) && (dram->array[bank_id].row_id == row_id))
 		{
 			dram_access_delay = cas + act + bus;
+			dram->stat_rowbuf_hit++;
 		}
 		//RAS + CAS
 		else 
 		{
 			dram_access_delay = act + cas + bus;
+			dram->stat_rowbuf_miss++;
 			dram->array[bank_id].valid = true;
 			dram->array[bank_id].row_id = row_id;
 		}
@@ -1,6 +1,7 @@
 #ifndef DRAM_H
 #define DRAM_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include "types.h"
 
@@ -32,6 +33,11 @@ struct DRAM{
     uint64_t stat_write_access;
     uint64_t stat_read_delay;
     uint64_t stat_write_delay;
+    uint64_t stat_rowbuf_hit;   // accesses that found their row open (Parts C,D,E)
+    uint64_t stat_rowbuf_miss;  // accesses to an empty or different row
+    uint64_t stat_host_ns;      // host time in dram_access(), HOST_PROFILE builds only
+
+    Sim_Config* cfg; //mode, linesize and page policy of the owning simulation
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////
@@ -52,8 +58,9 @@ struct DRAM{
 // Following functions might be helpful
 /////////////////////////////////////////////////////////////////////////////////////////////
 
-DRAM* dram_new();
-void dram_print_stats(DRAM* dram);
+DRAM* dram_new(Sim_Config* cfg);
+void dram_print_stats(DRAM* dram, FILE* out);
+void dram_print_rowbuf_stats(DRAM* dram, FILE* out);
 uint64_t dram_access(DRAM* dram, Addr lineaddr, bool is_dram_write);
 uint64_t dram_access_mode_CDE(DRAM* dram, Addr lineaddr, bool is_dram_write);
 
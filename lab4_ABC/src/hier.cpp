@@ -0,0 +1,262 @@
+ /*************************************************************************
+ * File         : hier.cpp
+ * Description  : Cache hierarchy descriptions, built in or read from a file
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+
+#include "hier.h"
+#include "sim.h"
+#include "cache.h"
+#include "prefetch.h"
+
+#define HIER_MAX_ARGS        64
+
+//---- Cache Latencies of the built-in hierarchies ------
+
+#define DCACHE_HIT_LATENCY   1
+#define ICACHE_HIT_LATENCY   1
+#define L2CACHE_HIT_LATENCY  10
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+bool hier_on_side(Hier_Level* l, Hier_Side side){
+	return l->side == HIER_SIDE_BOTH || l->side == side;
+}
+
+////////////////////////////////////////////////////////////////////
+// An inclusion policy by number or by name, e.g. "1" or "inclusive"
+////////////////////////////////////////////////////////////////////
+
+static const char* hier_inclusion_names[NUM_HIER_INCLUSION] = {
+	"noninclusive", "inclusive", "exclusive",
+};
+
+uint64_t hier_inclusion_parse(const char* s){
+	if (s[0] >= '0' && s[0] <= '9') {
+		uint64_t inclusion = strtoull(s, NULL, 10);
+		if (inclusion < NUM_HIER_INCLUSION) {
+			return inclusion;
+		}
+	}
+	for (uint64_t i=0; i<NUM_HIER_INCLUSION; i++) {
+		if (!strcasecmp(s, hier_inclusion_names[i])) {
+			return i;
+		}
+	}
+	printf("Inclusion policy is %s\n", s);
+	die_message("Unknown inclusion policy");
+	return HIER_NON_INCLUSIVE;
+}
+
+static Hier_Level* hier_add(Hier_Config* h, const char* name, uint64_t size, uint64_t assoc, uint64_t latency, bool shared, Hier_Side side){
+	Hier_Level* l = &h->level[h->num_levels++];
+	memset(l, 0, sizeof(Hier_Level));
+	snprintf(l->name, sizeof(l->name), "%s", name);
+	l->size     = size;
+	l->assoc    = assoc;
+	l->latency  = latency;
+	l->shared   = shared;
+	l->side     = side;
+	l->repl     = UINT64_MAX;
+	l->prefetch = PREFETCH_NONE;
+	l->prefetch_degree   = 2;
+	l->prefetch_distance = 1;
+	l->victim_latency    = 1;
+	l->write_allocate    = true;
+	return l;
+}
+
+////////////////////////////////////////////////////////////////////
+// The hierarchy of each mode: Part A has only the dcache, Parts B,C a
+// single icache, dcache and L2, Parts D,E per-core L1s and a shared L2
+////////////////////////////////////////////////////////////////////
+
+Hier_Config* hier_builtin(Sim_Config* cfg){
+	Hier_Config* h = (Hier_Config*)calloc(1, sizeof(Hier_Config));
+	bool multicore = (cfg->sim_mode == SIM_MODE_D || cfg->sim_mode == SIM_MODE_E);
+
+	if (cfg->sim_mode != SIM_MODE_A) {
+		hier_add(h, "ICACHE", cfg->icache_size, cfg->icache_assoc, ICACHE_HIT_LATENCY, !multicore, HIER_SIDE_INST);
+	}
+
+	Hier_Level* d = hier_add(h, "DCACHE", cfg->dcache_size, cfg->dcache_assoc, DCACHE_HIT_LATENCY, !multicore, HIER_SIDE_DATA);
+	d->prefetch          = cfg->dcache_prefetch;
+	d->prefetch_degree   = cfg->dcache_prefetch_degree;
+	d->prefetch_distance = cfg->dcache_prefetch_distance;
+	d->victim_entries    = cfg->dcache_victim_entries;
+	d->victim_latency    = cfg->dcache_victim_latency;
+	d->mshrs             = cfg->dcache_mshrs;
+	d->write_allocate    = !cfg->dcache_no_write_allocate;
+	d->write_through     = cfg->dcache_write_through;
+
+	if (cfg->sim_mode != SIM_MODE_A) {
+		Hier_Level* l2 = hier_add(h, "L2CACHE", cfg->l2cache_size, cfg->l2cache_assoc, L2CACHE_HIT_LATENCY, true, HIER_SIDE_BOTH);
+		l2->repl = cfg->l2cache_repl;
+		if (l2->repl == UINT64_MAX && multicore) {
+			l2->repl = CACHE_REPL_FIFO;
+		}
+		l2->inclusion         = (Hier_Inclusion)cfg->l2cache_inclusion;
+		l2->prefetch          = cfg->l2cache_prefetch;
+		l2->prefetch_degree   = cfg->l2cache_prefetch_degree;
+		l2->prefetch_distance = cfg->l2cache_prefetch_distance;
+		l2->mshrs             = cfg->l2cache_mshrs;
+		l2->write_allocate    = !cfg->l2cache_no_write_allocate;
+		l2->write_through     = cfg->l2cache_write_through;
+	}
+	return h;
+}
+
+////////////////////////////////////////////////////////////////////
+// One level per line, see hier.h. Blank lines and everything after a
+// '#' are ignored.
+////////////////////////////////////////////////////////////////////
+
+static void hier_die(const char* fname, uint64_t line_num, const char* msg){
+	printf("Hierarchy file is %s, line %" PRIu64 "\n", fname, line_num);
+	die_message(msg);
+}
+
+static void hier_parse_level(Hier_Level* l, int argc, char** argv, const char* fname, uint64_t line_num){
+	for (int i = 0; i < argc; i++) {
+		if (i == argc - 1) {
+			hier_die(fname, line_num, "Missing value for the last option");
+		}
+		const char* opt = argv[i];
+		const char* val = argv[++i];
+
+		if (!strcmp(opt, "-sizeKB")) {
+			l->size = strtoull(val, NULL, 10) * 1024;
+		}
+		else if (!strcmp(opt, "-assoc")) {
+			l->assoc = strtoull(val, NULL, 10);
+		}
+		else if (!strcmp(opt, "-latency")) {
+			l->latency = strtoull(val, NULL, 10);
+		}
+		else if (!strcmp(opt, "-sharing")) {
+			if (!strcmp(val, "private")) {
+				l->shared = false;
+			}
+			else if (!strcmp(val, "shared")) {
+				l->shared = true;
+			}
+			else {
+				hier_die(fname, line_num, "-sharing must be private or shared");
+			}
+		}
+		else if (!strcmp(opt, "-side")) {
+			if (!strcmp(val, "inst")) {
+				l->side = HIER_SIDE_INST;
+			}
+			else if (!strcmp(val, "data")) {
+				l->side = HIER_SIDE_DATA;
+			}
+			else if (!strcmp(val, "both")) {
+				l->side = HIER_SIDE_BOTH;
+			}
+			else {
+				hier_die(fname, line_num, "-side must be inst, data or both");
+			}
+		}
+		else if (!strcmp(opt, "-repl")) {
+			l->repl = cache_repl_parse(val);
+		}
+		else if (!strcmp(opt, "-inclusion")) {
+			l->inclusion = (Hier_Inclusion)hier_inclusion_parse(val);
+		}
+		else if (!strcmp(opt, "-victim")) {
+			l->victim_entries = strtoull(val, NULL, 10);
+		}
+		else if (!strcmp(opt, "-victim_latency")) {
+			l->victim_latency = strtoull(val, NULL, 10);
+		}
+		else if (!strcmp(opt, "-write_allocate")) {
+			l->write_allocate = strtoull(val, NULL, 10) != 0;
+		}
+		else if (!strcmp(opt, "-write_through")) {
+			l->write_through = strtoull(val, NULL, 10) != 0;
+		}
+		else if (!strcmp(opt, "-mshr")) {
+			l->mshrs = strtoull(val, NULL, 10);
+		}
+		else if (!strcmp(opt, "-prefetch")) {
+			l->prefetch = prefetch_parse(val);
+		}
+		else if (!strcmp(opt, "-prefetch_degree")) {
+			l->prefetch_degree = strtoull(val, NULL, 10);
+		}
+		else if (!strcmp(opt, "-prefetch_distance")) {
+			l->prefetch_distance = strtoull(val, NULL, 10);
+		}
+		else {
+			char msg[256];
+			snprintf(msg, sizeof(msg), "Invalid hierarchy option %s", opt);
+			hier_die(fname, line_num, msg);
+		}
+	}
+
+	if (l->size == 0 || l->assoc == 0) {
+		hier_die(fname, line_num, "Every level needs -sizeKB and -assoc");
+	}
+	if (l->victim_entries && l->inclusion == HIER_EXCLUSIVE) {
+		hier_die(fname, line_num, "An exclusive level cannot have a victim cache");
+	}
+}
+
+Hier_Config* hier_read(const char* fname){
+	FILE* f = fopen(fname, "r");
+	if (f == NULL) {
+		printf("Hierarchy file is %s\n", fname);
+		die_message("Unable to open the hierarchy file");
+	}
+
+	Hier_Config* h = (Hier_Config*)calloc(1, sizeof(Hier_Config));
+	char line[4096];
+	uint64_t line_num = 0;
+	while (fgets(line, sizeof(line), f)) {
+		line_num++;
+		char* args[HIER_MAX_ARGS];
+		int num_args = sim_config_split(line, args, HIER_MAX_ARGS);
+		if (num_args < 0) {
+			hier_die(fname, line_num, "Too many options on one hierarchy line");
+		}
+		if (num_args == 0) {
+			continue;
+		}
+		if (h->num_levels == HIER_MAX_LEVELS) {
+			hier_die(fname, line_num, "Too many levels in the cache hierarchy");
+		}
+		Hier_Level* l = hier_add(h, args[0], 0, 0, 1, true, HIER_SIDE_BOTH);
+		hier_parse_level(l, num_args-1, args+1, fname, line_num);
+	}
+	fclose(f);
+
+	if (h->num_levels == 0) {
+		die_message("No levels in the hierarchy file");
+	}
+
+	// a private cache below a shared one would see only some of the
+	// misses to its lines
+	Hier_Side sides[2] = {HIER_SIDE_INST, HIER_SIDE_DATA};
+	for (uint64_t s=0; s<2; s++) {
+		bool below_shared = false;
+		for (uint64_t k=0; k<h->num_levels; k++) {
+			Hier_Level* l = &h->level[k];
+			if (!hier_on_side(l, sides[s])) {
+				continue;
+			}
+			if (below_shared && !l->shared) {
+				printf("Hierarchy file is %s, level %s\n", fname, l->name);
+				die_message("A private level cannot be below a shared one");
+			}
+			below_shared |= l->shared;
+		}
+	}
+	return h;
+}
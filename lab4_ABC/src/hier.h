@@ -0,0 +1,115 @@
+#ifndef HIER_H
+#define HIER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "types.h"
+
+//////////////////////////////////////////////////////////////////
+// Description of the cache hierarchy memsys builds. Modes B-E use a
+// built-in one made from the -D/-I/-L2 options (hier_builtin()); -hier
+// reads one from a file instead, one level per line:
+//
+//   <name> -sizeKB <num> -assoc <num> [-latency <num>] [-sharing private|shared]
+//          [-side inst|data|both] [-repl <policy>] [-prefetch <type>]
+//          [-prefetch_degree <num>] [-prefetch_distance <num>]
+//          [-inclusion inclusive|noninclusive|exclusive]
+//          [-victim <entries>] [-victim_latency <num>] [-mshr <num>]
+//          [-write_allocate 0|1] [-write_through 0|1]
+//
+// e.g. split private L1s, private L2s and a shared L3:
+//
+//   ICACHE  -sizeKB 32   -assoc 8  -latency 1  -sharing private -side inst
+//   DCACHE  -sizeKB 32   -assoc 8  -latency 1  -sharing private -side data
+//   L2CACHE -sizeKB 256  -assoc 8  -latency 10 -sharing private
+//   L3CACHE -sizeKB 4096 -assoc 16 -latency 30 -sharing shared
+//
+// An access walks the levels on its side (instruction fetches the inst
+// and both levels, loads and stores the data and both levels) in file
+// order and ends at DRAM. A private level has one cache per core, and
+// its stats are printed as <name>_<core>. Below a shared level every
+// level must be shared too.
+//
+// -inclusion relates a level to the caches above it (on any path that
+// reaches it, for every core if it is shared):
+//   noninclusive: misses fill every level on the way up, and evictions
+//     only write dirty lines back (the default)
+//   inclusive: a line the level evicts is also removed from every cache
+//     above it (back-invalidation)
+//   exclusive: a line the level above misses on moves up and leaves this
+//     level, which is filled only by the victims of the level above
+//
+// -victim adds a small fully-associative LRU victim cache to each cache
+// of the level. It takes every line the cache evicts; a miss that hits
+// in it swaps the line back in after victim_latency more cycles instead
+// of going to the level below. Lines it evicts are written back as the
+// cache's own victims were. Being exclusive already, it cannot be
+// combined with -inclusion exclusive.
+//
+// -mshr gives each cache of the level that many MSHRs (see mshr.h), so
+// misses to a line already in flight merge and wait for the rest of its
+// fill, and misses stall while every MSHR is busy. Without it the level
+// takes any number of misses at once.
+//
+// -write_allocate 0 makes a store that misses pass the write on to the
+// level below instead of reading the line in. -write_through 1 passes
+// every write on and keeps the level's lines clean. Nobody waits for
+// the writes passed on. Levels are write-allocate and write-back by
+// default; neither option goes with an exclusive level below.
+//////////////////////////////////////////////////////////////////
+
+#define HIER_MAX_LEVELS      8
+#define HIER_NAME_LEN        32
+
+typedef struct Hier_Level Hier_Level;
+typedef struct Hier_Config Hier_Config;
+
+typedef enum Hier_Inclusion_Enum {
+	HIER_NON_INCLUSIVE=0,
+	HIER_INCLUSIVE=1,
+	HIER_EXCLUSIVE=2,
+	NUM_HIER_INCLUSION
+} Hier_Inclusion;
+
+typedef enum Hier_Side_Enum {
+	HIER_SIDE_BOTH=0,
+	HIER_SIDE_INST=1,
+	HIER_SIDE_DATA=2,
+} Hier_Side;
+
+struct Hier_Level {
+	char      name[HIER_NAME_LEN];
+	uint64_t  size;              // bytes
+	uint64_t  assoc;
+	uint64_t  latency;           // hit latency in cycles
+	bool      shared;            // one cache for all cores, else one per core
+	Hier_Side side;
+	uint64_t  repl;              // a Cache_Repl, UINT64_MAX: the -repl policy
+	uint64_t  prefetch;          // a Prefetch_Type
+	uint64_t  prefetch_degree;
+	uint64_t  prefetch_distance;
+	Hier_Inclusion inclusion;    // towards the caches above
+	uint64_t  victim_entries;    // 0: no victim cache
+	uint64_t  victim_latency;    // extra cycles of a victim cache hit
+	uint64_t  mshrs;             // 0: not modeled
+	bool      write_allocate;    // a store miss reads the line in, else it is passed on
+	bool      write_through;     // writes are passed on, else written back on eviction
+};
+
+struct Hier_Config {
+	Hier_Level level[HIER_MAX_LEVELS];
+	uint64_t num_levels;
+};
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+Hier_Config* hier_read(const char* fname);
+Hier_Config* hier_builtin(Sim_Config* cfg);
+bool hier_on_side(Hier_Level* l, Hier_Side side);
+uint64_t hier_inclusion_parse(const char* s);
+
+//////////////////////////////////////////////////////////////////
+
+#endif // HIER_H
@@ -0,0 +1,34 @@
+#ifndef HOSTPROF_H
+#define HOSTPROF_H
+
+#include <stdint.h>
+#include <time.h>
+
+//////////////////////////////////////////////////////////////////
+// Host-time profiling of the simulator itself: where the wall-clock
+// time of a run goes (trace decode, cache lookups, DRAM model, stats).
+// Build with "make HOST_PROFILE=1" to enable it; otherwise the macros
+// below expand to nothing and the counters stay zero.
+//////////////////////////////////////////////////////////////////
+
+#ifndef HOST_PROFILE
+#define HOST_PROFILE 0
+#endif
+
+static inline uint64_t hostprof_now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#if HOST_PROFILE
+#define HOSTPROF_START(start)         uint64_t start = hostprof_now()
+#define HOSTPROF_ADD(counter, start)  ((counter) += hostprof_now() - (start))
+#else
+#define HOSTPROF_START(start)
+#define HOSTPROF_ADD(counter, start)
+#endif
+
+//////////////////////////////////////////////////////////////////
+
+#endif // HOSTPROF_H
@@ -0,0 +1,221 @@
+ /*************************************************************************
+ * File         : interval.cpp
+ * Description  : Periodic interval statistics as a CSV or JSON time series
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "interval.h"
+
+extern void die_message(const char* msg);
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+static void interval_add_cache(Interval* iv, Cache* c, const char* name){
+	Interval_Cache* ic = &iv->caches[iv->num_caches++];
+	ic->c = c;
+	snprintf(ic->name, sizeof(ic->name), "%s", name);
+}
+
+Interval* interval_new(Sim_Config* cfg, Memsys* memsys, Core** core){
+	Interval* iv = (Interval*)calloc(1, sizeof(Interval));
+
+	iv->by_inst = (cfg->interval_inst != 0);
+	iv->period  = iv->by_inst ? cfg->interval_inst : cfg->interval_cycles;
+	iv->next    = iv->period;
+
+	iv->out = fopen(cfg->interval_out, "w");
+	if (iv->out == NULL) {
+		printf("Interval file is %s\n", cfg->interval_out);
+		die_message("Unable to create the interval stats file");
+	}
+	uint64_t len = strlen(cfg->interval_out);
+	iv->json = (len >= 5 && !strcmp(cfg->interval_out + len - 5, ".json"));
+
+	iv->memsys    = memsys;
+	iv->core      = core;
+	iv->num_cores = cfg->num_cores;
+	iv->last_inst = (uint64_t*)calloc(iv->num_cores, sizeof(uint64_t));
+
+	iv->caches = (Interval_Cache*)calloc(memsys->num_caches, sizeof(Interval_Cache));
+	for (uint64_t k=0; k<memsys->num_caches; k++) {
+		interval_add_cache(iv, memsys->caches[k].c, memsys->caches[k].header);
+	}
+
+	if (iv->json) {
+		fprintf(iv->out, "[");
+	}
+	return iv;
+}
+
+void interval_free(Interval* iv){
+	if (iv->out) {
+		fclose(iv->out);
+	}
+	free(iv->last_inst);
+	free(iv->caches);
+	free(iv);
+}
+
+////////////////////////////////////////////////////////////////////
+// One column of a sample. In the header pass of a CSV file the column
+// name is written instead of the value.
+////////////////////////////////////////////////////////////////////
+
+static void interval_put(Interval* iv, bool header, uint64_t* col, const char* name, double v, bool integer){
+	const char* sep = (*col)++ ? (iv->json ? ", " : ",") : "";
+	if (header) {
+		fprintf(iv->out, "%s%s", sep, name);
+	}
+	else if (iv->json) {
+		fprintf(iv->out, integer ? "%s\"%s\": %.0f" : "%s\"%s\": %.3f", sep, name, v);
+	}
+	else {
+		fprintf(iv->out, integer ? "%s%.0f" : "%s%.3f", sep, v);
+	}
+}
+
+static double interval_ratio(uint64_t num, uint64_t den, double scale){
+	return den ? scale * (double)num / (double)den : 0;
+}
+
+////////////////////////////////////////////////////////////////////
+// Everything since the previous sample, ending at cycle
+////////////////////////////////////////////////////////////////////
+
+static void interval_row(Interval* iv, uint64_t cycle, bool header){
+	char name[64];
+	uint64_t col = 0;
+	uint64_t cycles = cycle - iv->last_cycle;
+
+	uint64_t total_inst = 0;
+	for (uint64_t i=0; i<iv->num_cores; i++) {
+		total_inst += iv->core[i]->inst_count;
+	}
+
+	if (iv->json) {
+		fprintf(iv->out, "%s\n  {", iv->num_samples ? "," : "");
+	}
+	interval_put(iv, header, &col, "CYCLE", cycle, true);
+	interval_put(iv, header, &col, "INST", total_inst, true);
+
+	for (uint64_t i=0; i<iv->num_cores; i++) {
+		uint64_t inst = iv->core[i]->inst_count;
+		sprintf(name, "CORE_%llu_IPC", (unsigned long long)i);
+		interval_put(iv, header, &col, name, interval_ratio(inst - iv->last_inst[i], cycles, 1), false);
+		if (!header) {
+			iv->last_inst[i] = inst;
+		}
+	}
+
+	for (uint64_t k=0; k<iv->num_caches; k++) {
+		Interval_Cache* ic = &iv->caches[k];
+		uint64_t access = ic->c->stat_read_access + ic->c->stat_write_access;
+		uint64_t miss   = ic->c->stat_read_miss + ic->c->stat_write_miss;
+		sprintf(name, "%s_ACCESS", ic->name);
+		interval_put(iv, header, &col, name, access - ic->last_access, true);
+		sprintf(name, "%s_MISS_PERC", ic->name);
+		interval_put(iv, header, &col, name, interval_ratio(miss - ic->last_miss, access - ic->last_access, 100), false);
+		if (!header) {
+			ic->last_access = access;
+			ic->last_miss   = miss;
+		}
+	}
+
+	Memsys_Stats mem;
+	memsys_total_stats(iv->memsys, &mem);
+	Memsys_Stats* last = &iv->last_mem;
+	interval_put(iv, header, &col, "MEMSYS_IFETCH_AVGDELAY",
+	             interval_ratio(mem.stat_ifetch_delay - last->stat_ifetch_delay, mem.stat_ifetch_access - last->stat_ifetch_access, 1), false);
+	interval_put(iv, header, &col, "MEMSYS_LOAD_AVGDELAY",
+	             interval_ratio(mem.stat_load_delay - last->stat_load_delay, mem.stat_load_access - last->stat_load_access, 1), false);
+	interval_put(iv, header, &col, "MEMSYS_STORE_AVGDELAY",
+	             interval_ratio(mem.stat_store_delay - last->stat_store_delay, mem.stat_store_access - last->stat_store_access, 1), false);
+	if (!header) {
+		*last = mem;
+	}
+
+	DRAM* dram = iv->memsys->dram;
+	if (dram) {
+		uint64_t access   = dram->stat_read_access + dram->stat_write_access;
+		uint64_t delay    = dram->stat_read_delay + dram->stat_write_delay;
+		uint64_t row_hit  = dram->stat_rowbuf_hit;
+		uint64_t row_miss = dram->stat_rowbuf_miss;
+		interval_put(iv, header, &col, "DRAM_ACCESS", access - iv->last_dram_access, true);
+		interval_put(iv, header, &col, "DRAM_AVGDELAY",
+		             interval_ratio(delay - iv->last_dram_delay, access - iv->last_dram_access, 1), false);
+		interval_put(iv, header, &col, "DRAM_ROWBUF_HIT_PERC",
+		             interval_ratio(row_hit - iv->last_rowbuf_hit,
+		                            (row_hit - iv->last_rowbuf_hit) + (row_miss - iv->last_rowbuf_miss), 100), false);
+		if (!header) {
+			iv->last_dram_access = access;
+			iv->last_dram_delay  = delay;
+			iv->last_rowbuf_hit  = row_hit;
+			iv->last_rowbuf_miss = row_miss;
+		}
+	}
+
+	fprintf(iv->out, iv->json ? "}" : "\n");
+}
+
+static void interval_sample(Interval* iv, uint64_t cycle){
+	if (!iv->json && iv->num_samples == 0) {
+		interval_row(iv, cycle, true);
+	}
+	interval_row(iv, cycle, false);
+	iv->last_cycle = cycle;
+	iv->num_samples++;
+}
+
+////////////////////////////////////////////////////////////////////
+// Called once cycles [0, cycle) have been simulated
+////////////////////////////////////////////////////////////////////
+
+void interval_cycle(Interval* iv, uint64_t cycle){
+	if (!iv->by_inst) {
+		interval_skip(iv, cycle);
+		return;
+	}
+
+	uint64_t total_inst = 0;
+	for (uint64_t i=0; i<iv->num_cores; i++) {
+		total_inst += iv->core[i]->inst_count;
+	}
+	if (total_inst >= iv->next) {
+		interval_sample(iv, cycle);
+		iv->next = (total_inst / iv->period + 1) * iv->period;
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+// Event-driven mode: no counter changes before cycle, so every
+// sample boundary up to it sees the current counters
+////////////////////////////////////////////////////////////////////
+
+void interval_skip(Interval* iv, uint64_t cycle){
+	if (iv->by_inst) {
+		return;
+	}
+	while (iv->next <= cycle) {
+		interval_sample(iv, iv->next);
+		iv->next += iv->period;
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+// The last, partial interval ends with the run
+////////////////////////////////////////////////////////////////////
+
+void interval_finish(Interval* iv, uint64_t cycle){
+	if (cycle > iv->last_cycle) {
+		interval_sample(iv, cycle);
+	}
+	if (iv->json) {
+		fprintf(iv->out, "\n]\n");
+	}
+	fclose(iv->out);
+	iv->out = NULL;
+}
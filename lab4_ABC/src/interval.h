@@ -0,0 +1,71 @@
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "memsys.h"
+#include "core.h"
+
+//////////////////////////////////////////////////////////////////
+// Interval statistics: every interval_cycles cycles (or every
+// interval_inst instructions over all cores) write one sample of what
+// happened since the previous one: per-core IPC, per-cache miss rates,
+// average MEMSYS delays and DRAM row-buffer hit rate. The end-of-run
+// totals hide phases, e.g. one core thrashing the shared L2 for a
+// while; the time series shows them.
+//
+// The samples go to interval_out as CSV, or as a JSON array of
+// objects when the file name ends in ".json".
+//////////////////////////////////////////////////////////////////
+
+typedef struct Interval_Cache Interval_Cache;
+typedef struct Interval Interval;
+
+struct Interval_Cache {
+	Cache* c;
+	char name[32];
+	uint64_t last_access;
+	uint64_t last_miss;
+};
+
+struct Interval {
+	FILE* out;
+	bool json;
+
+	uint64_t period;
+	bool by_inst;      // period counts instructions, else cycles
+	uint64_t next;     // cycle or instruction count of the next sample
+
+	Memsys* memsys;
+	Core** core;
+	uint64_t num_cores;
+
+	Interval_Cache* caches;   // in the order memsys_print_stats() prints them
+	uint64_t num_caches;
+
+	// counters at the previous sample
+	uint64_t last_cycle;
+	uint64_t* last_inst;
+	Memsys_Stats last_mem;
+	uint64_t last_dram_access;
+	uint64_t last_dram_delay;
+	uint64_t last_rowbuf_hit;
+	uint64_t last_rowbuf_miss;
+
+	uint64_t num_samples;
+};
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+Interval* interval_new(Sim_Config* cfg, Memsys* memsys, Core** core);
+void interval_free(Interval* iv);
+void interval_cycle(Interval* iv, uint64_t cycle);
+void interval_skip(Interval* iv, uint64_t cycle);
+void interval_finish(Interval* iv, uint64_t cycle);
+
+//////////////////////////////////////////////////////////////////
+
+#endif // INTERVAL_H
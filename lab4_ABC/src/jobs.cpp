@@ -0,0 +1,158 @@
+ /*************************************************************************
+ * File         : jobs.cpp
+ * Description  : Batch runner: independent simulations on a worker pool
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
+
+#include "sim.h"
+#include "jobs.h"
+
+#define JOBS_MAX_ARGS 256
+
+typedef struct Job Job;
+typedef struct Jobs Jobs;
+
+struct Job {
+	Sim_Config cfg;
+	char out_fname[1024];
+};
+
+struct Jobs {
+	Job* jobs;
+	uint64_t num_jobs;
+
+	std::atomic<uint64_t> next_job;
+
+	std::mutex print_lock;
+	uint64_t jobs_done;
+};
+
+////////////////////////////////////////////////////////////////////
+// One simulation per line: "<output file> [-option <value>] ...
+// [trace_0 trace_1 ...]". Without traces the line runs on the
+// command-line traces. Blank lines and everything after a '#' are
+// ignored. The whole file is parsed before any job starts, so a typo
+// on the last line does not waste the runs before it.
+////////////////////////////////////////////////////////////////////
+
+static void jobs_read_file(Jobs* js, Sim_Config* base, const char* jobs_fname){
+	FILE* f = fopen(jobs_fname, "r");
+	if (f == NULL) {
+		printf("Jobs file is %s\n", jobs_fname);
+		die_message("Unable to open the jobs file");
+	}
+
+	uint64_t max_jobs = 64;
+	js->jobs = (Job*)calloc(max_jobs, sizeof(Job));
+
+	char line[4096];
+	uint64_t line_num = 0;
+	while (fgets(line, sizeof(line), f)) {
+		line_num++;
+		char* args[JOBS_MAX_ARGS];
+		int num_args = sim_config_split(line, args, JOBS_MAX_ARGS);
+		if (num_args < 0) {
+			printf("Jobs file is %s, line %" PRIu64 "\n", jobs_fname, line_num);
+			die_message("Too many options on one jobs line");
+		}
+		if (num_args == 0) {
+			continue;
+		}
+
+		if (js->num_jobs == max_jobs) {
+			max_jobs *= 2;
+			js->jobs = (Job*)realloc(js->jobs, max_jobs * sizeof(Job));
+		}
+		Job* job = &js->jobs[js->num_jobs++];
+		memset(job, 0, sizeof(Job));
+		strncpy(job->out_fname, args[0], sizeof(job->out_fname)-1);
+		job->cfg = *base;
+		sim_config_parse(&job->cfg, num_args-1, args+1, SIM_CONFIG_JOB);
+	}
+	fclose(f);
+
+	if (js->num_jobs == 0) {
+		die_message("No jobs in the jobs file");
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+// Workers take jobs in file order until none are left. A job runs to
+// completion on the worker that took it.
+////////////////////////////////////////////////////////////////////
+
+static void jobs_worker(Jobs* js){
+	uint64_t j;
+	while ((j = js->next_job.fetch_add(1)) < js->num_jobs) {
+		Job* job = &js->jobs[j];
+
+		Sim* sim = sim_new(&job->cfg, NULL);
+		sim_run(sim, UINT64_MAX);
+
+		FILE* out = fopen(job->out_fname, "w");
+		if (out == NULL) {
+			printf("Output file is %s\n", job->out_fname);
+			die_message("Unable to create the job output file");
+		}
+		sim_print_stats(sim, out);
+		fclose(out);
+
+		std::lock_guard<std::mutex> guard(js->print_lock);
+		js->jobs_done++;
+		printf("JOB %4" PRIu64 "/%-4" PRIu64 " %-40s CYCLES %12" PRIu64 "\n",
+		       js->jobs_done, js->num_jobs, job->out_fname, sim->cycle);
+		fflush(stdout);
+		sim_free(sim);
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+void jobs_run(Sim_Config* base, const char* jobs_fname, uint64_t num_threads){
+	Jobs* js = new Jobs();
+	js->next_job = 0;
+	js->jobs_done = 0;
+	jobs_read_file(js, base, jobs_fname);
+
+	if (num_threads == 0) {
+		num_threads = std::thread::hardware_concurrency();
+	}
+	if (num_threads == 0) {
+		num_threads = 1;
+	}
+	if (num_threads > js->num_jobs) {
+		num_threads = js->num_jobs;
+	}
+
+	printf("JOBS %" PRIu64 " simulations, %" PRIu64 " worker threads\n", js->num_jobs, num_threads);
+	fflush(stdout);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	std::vector<std::thread> workers;
+	for (uint64_t w=0; w<num_threads; w++) {
+		workers.push_back(std::thread(jobs_worker, js));
+	}
+	for (uint64_t w=0; w<num_threads; w++) {
+		workers[w].join();
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("\nJOBS_SIMULATIONS     \t : %10llu", (unsigned long long)js->num_jobs);
+	printf("\nJOBS_THREADS         \t : %10llu", (unsigned long long)num_threads);
+	printf("\nJOBS_HOST_SECONDS    \t : %10.3f", secs);
+	printf("\n\n");
+}
@@ -0,0 +1,20 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdint.h>
+
+#include "types.h"
+
+//////////////////////////////////////////////////////////////////
+// Batch mode: run a list of independent simulations in one process,
+// as scripts/runall.sh does with one sim per line. Each job is a full
+// Sim with its own traces, so jobs may use different trace mixes.
+// A pool of worker threads takes the next job as soon as it is free;
+// each job writes its stats to its own output file.
+//////////////////////////////////////////////////////////////////
+
+void jobs_run(Sim_Config* base, const char* jobs_fname, uint64_t num_threads);
+
+//////////////////////////////////////////////////////////////////
+
+#endif // JOBS_H
@@ -4,360 +4,870 @@
 #include <stdlib.h>
 #include <math.h>
 #include <iostream>
+#include <unordered_set>
+#include <algorithm>
 
 #include "memsys.h"
+#include "hostprof.h"
 
-#define PAGE_SIZE 4096
+extern void die_message(const char* msg);
 
-//---- Cache Latencies  ------
+#define PAGE_SIZE 4096              // frames of memsys_convert_vpn_to_pfn(), page tables
+#define HUGE_PAGE_SIZE (2048*1024)
 
-#define DCACHE_HIT_LATENCY   1
-#define ICACHE_HIT_LATENCY   1
-#define L2CACHE_HIT_LATENCY  10
+static uint64_t memsys_path_access(Memsys* sys, Memsys_Path* p, uint64_t k, Addr lineaddr, bool is_write, bool is_writeback, uint32_t core_id);
+static Addr memsys_translate(Memsys* sys, Addr v_lineaddr, uint32_t core_id);
+static uint64_t memsys_tlb_access(Memsys* sys, Addr v_lineaddr, bool is_ifetch, uint32_t core_id);
+static uint64_t memsys_page_size(Memsys* sys, Addr addr);
 
-extern MODE   SIM_MODE;
-extern uint64_t  CACHE_LINESIZE;
-extern uint64_t  REPL_POLICY;
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
 
-extern uint64_t  DCACHE_SIZE;
-extern uint64_t  DCACHE_ASSOC;
-extern uint64_t  ICACHE_SIZE;
-extern uint64_t  ICACHE_ASSOC;
-extern uint64_t  L2CACHE_SIZE;
-extern uint64_t  L2CACHE_ASSOC;
-extern uint64_t  L2CACHE_REPL;
-extern uint64_t  NUM_CORES;
 
 ////////////////////////////////////////////////////////////////////
+// Caches run on the clock of whoever accesses them; the static way
+// partitions of SWP/NEW, the UCP epoch, the random seed, the
+// stack-distance profiling and whether to use a specialized cache
+// (cache_specialize()) come from the configuration, everything else
+// from the level of the hierarchy
 ////////////////////////////////////////////////////////////////////
 
+static Cache* memsys_cache_new(Memsys* sys, Memsys_Level* level, uint32_t core_id, const char* header, const uint64_t* clock){
+	Sim_Config* cfg = sys->cfg;
+	Hier_Level* l = level->cfg;
+	uint64_t repl_policy = (l->repl == UINT64_MAX) ? cfg->repl_policy : l->repl;
+	Cache* c = cache_new(l->size, l->assoc, cfg->cache_linesize, repl_policy, cfg->num_cores, clock);
+	cache_seed(c, cfg->repl_seed + (sys->num_caches << 32));
+	cache_set_quotas(c, cfg->swp_core0_ways, cfg->swp_quotas);
+	c->ucp_epoch_cycles = cfg->ucp_epoch_cycles;
+	c->ucp_next_epoch = cfg->ucp_epoch_cycles;
+	if (cfg->cache_specialize) {
+		cache_specialize(c);
+	}
+	if (cfg->sdprof_depth) {
+		c->sdprof = sdprof_new(cfg->sdprof_min_size, cfg->sdprof_max_size, cfg->cache_linesize, l->assoc, cfg->sdprof_depth);
+	}
+	if (l->prefetch != PREFETCH_NONE) {
+		cache_set_prefetcher(c, prefetch_new(l->prefetch, l->prefetch_degree, l->prefetch_distance));
+	}
+	if (l->mshrs) {
+		c->mshr = mshr_new(l->mshrs);
+	}
+	if (cfg->layout_stats) {
+		c->stat_set_misses = (uint64_t*)calloc(c->number_sets, sizeof(uint64_t));
+	}
 
-Memsys* memsys_new(void){
+	Memsys_Cache* mc = &sys->caches[sys->num_caches++];
+	mc->c       = c;
+	mc->header  = strdup(header);
+	mc->level   = level;
+	mc->core_id = core_id;
+	return c;
+}
+
+// A victim cache is a single fully-associative LRU set
+static Cache* memsys_victim_new(Memsys* sys, Memsys_Level* level, const uint64_t* clock){
+	Sim_Config* cfg = sys->cfg;
+	uint64_t entries = level->cfg->victim_entries;
+	Cache* vc = cache_new(entries * cfg->cache_linesize, entries, cfg->cache_linesize, CACHE_REPL_LRU, cfg->num_cores, clock);
+	if (cfg->cache_specialize) {
+		cache_specialize(vc);
+	}
+	return vc;
+}
+
+static void memsys_path_add(Memsys_Path* p, Memsys_Level* l){
+	p->level[p->num_levels++] = l;
+}
+
+Memsys* memsys_new(Sim_Config* cfg, const uint64_t* clock, Parsim* par){
 	Memsys* sys = (Memsys*)calloc(1, sizeof (Memsys));
+	sys->cfg   = cfg;
+	sys->clock = clock;
+	sys->par   = par;
+
+	uint64_t num_cores = cfg->num_cores;
+
+	sys->core_stats = (Memsys_Stats*)aligned_alloc(alignof(Memsys_Stats), num_cores * sizeof(Memsys_Stats));
+	memset(sys->core_stats, 0, num_cores * sizeof(Memsys_Stats));
+	sys->access_pc = (Addr*)calloc(num_cores, sizeof(Addr));
+	sys->fill_dirty = (bool*)calloc(num_cores, sizeof(bool));
+	sys->access_cycle = (uint64_t*)calloc(num_cores, sizeof(uint64_t));
+	sys->access_page_size = (uint64_t*)calloc(num_cores, sizeof(uint64_t));
+	for (uint64_t i=0; i<num_cores; i++) {
+		sys->access_page_size[i] = cfg->page_size;
+	}
 
-	switch(SIM_MODE) {
-		case SIM_MODE_A:
-			sys->dcache = cache_new(DCACHE_SIZE, DCACHE_ASSOC, CACHE_LINESIZE, REPL_POLICY);
-			break;  
-
-		case SIM_MODE_B:
-		case SIM_MODE_C:
-			sys->dcache = cache_new(DCACHE_SIZE, DCACHE_ASSOC, CACHE_LINESIZE, REPL_POLICY);
-			sys->icache = cache_new(ICACHE_SIZE, ICACHE_ASSOC, CACHE_LINESIZE, REPL_POLICY);
-			sys->l2cache = cache_new(L2CACHE_SIZE, L2CACHE_ASSOC, CACHE_LINESIZE, REPL_POLICY);
-			sys->dram = dram_new();
-			break;
+	sys->hier = cfg->hier ? cfg->hier : hier_builtin(cfg);
+	sys->num_levels = sys->hier->num_levels;
+	sys->caches = (Memsys_Cache*)calloc(sys->num_levels * num_cores, sizeof(Memsys_Cache));
 
-		case SIM_MODE_D:
-		case SIM_MODE_E:
-			for (int i=0; i<NUM_CORES; i++) {
-				sys->dcache_coreid[i] = cache_new(DCACHE_SIZE, DCACHE_ASSOC, CACHE_LINESIZE, REPL_POLICY);
-				sys->icache_coreid[i] = cache_new(ICACHE_SIZE, ICACHE_ASSOC, CACHE_LINESIZE, REPL_POLICY);
+	for (uint64_t k=0; k<sys->num_levels; k++) {
+		Memsys_Level* l = &sys->level[k];
+		l->cfg = &sys->hier->level[k];
+		l->cache = (Cache**)calloc(num_cores, sizeof(Cache*));
+		if (l->cfg->victim_entries) {
+			l->victim = (Cache**)calloc(num_cores, sizeof(Cache*));
+		}
+		if (hier_on_side(l->cfg, HIER_SIDE_INST)) {
+			memsys_path_add(&sys->ipath, l);
+		}
+		if (hier_on_side(l->cfg, HIER_SIDE_DATA)) {
+			memsys_path_add(&sys->dpath, l);
+		}
+		for (uint64_t j=0; j<k; j++) {
+			Memsys_Level* a = &sys->level[j];
+			if ((hier_on_side(a->cfg, HIER_SIDE_INST) && hier_on_side(l->cfg, HIER_SIDE_INST)) ||
+			    (hier_on_side(a->cfg, HIER_SIDE_DATA) && hier_on_side(l->cfg, HIER_SIDE_DATA))) {
+				l->above[l->num_above++] = a;
+				a->below_inclusive |= (l->cfg->inclusion == HIER_INCLUSIVE);
+				// an exclusive level only ever hears of the lines the level above drops
+				if (l->cfg->inclusion == HIER_EXCLUSIVE && (a->cfg->write_through || !a->cfg->write_allocate)) {
+					die_message("A write-through or no-write-allocate level cannot be above an exclusive one");
+				}
 			}
-			sys->l2cache = cache_new(L2CACHE_SIZE, L2CACHE_ASSOC, CACHE_LINESIZE, L2CACHE_REPL);
-			sys->dram = dram_new();
-			break;
-		default:
-			break;
+		}
+
+		// back-invalidation reaches into the private caches of other cores
+		if (par && l->cfg->shared && l->cfg->inclusion == HIER_INCLUSIVE) {
+			for (uint64_t j=0; j<l->num_above; j++) {
+				if (!l->above[j]->cfg->shared) {
+					die_message("-parallel cannot be combined with an inclusive shared level below private ones");
+				}
+			}
+		}
+	}
+
+	// the private caches core by core, then the shared ones. With the
+	// parallel engine each core's private caches follow its own clock,
+	// and the shared ones the clock of the core being served.
+	char header[256];
+	for (uint64_t i=0; i<num_cores; i++) {
+		const uint64_t* core_clock = par ? parsim_core_clock(par, i) : clock;
+		for (uint64_t k=0; k<sys->num_levels; k++) {
+			Memsys_Level* l = &sys->level[k];
+			if (!l->cfg->shared) {
+				snprintf(header, sizeof(header), "%s_%llu", l->cfg->name, (unsigned long long)i);
+				l->cache[i] = memsys_cache_new(sys, l, i, header, core_clock);
+				if (l->victim) {
+					l->victim[i] = memsys_victim_new(sys, l, core_clock);
+				}
+			}
+		}
+	}
+	for (uint64_t k=0; k<sys->num_levels; k++) {
+		Memsys_Level* l = &sys->level[k];
+		if (l->cfg->shared) {
+			const uint64_t* shared_clock = par ? parsim_shared_clock(par) : clock;
+			Cache* c = memsys_cache_new(sys, l, 0, l->cfg->name, shared_clock);
+			Cache* vc = l->victim ? memsys_victim_new(sys, l, shared_clock) : NULL;
+			for (uint64_t i=0; i<num_cores; i++) {
+				l->cache[i] = c;
+				if (vc) {
+					l->victim[i] = vc;
+				}
+			}
+		}
+	}
+
+	// Part A has no DRAM, and does not simulate timing
+	if (cfg->sim_mode != SIM_MODE_A) {
+		sys->dram = dram_new(cfg);
+	}
+
+	// a TLB is a cache of one-"byte" lines, one per page number
+	if (cfg->tlb) {
+		sys->itlb = (Cache**)calloc(num_cores, sizeof(Cache*));
+		sys->dtlb = (Cache**)calloc(num_cores, sizeof(Cache*));
+		for (uint64_t i=0; i<num_cores; i++) {
+			const uint64_t* core_clock = par ? parsim_core_clock(par, i) : clock;
+			sys->itlb[i] = cache_new(cfg->itlb_entries, cfg->itlb_assoc, 1, CACHE_REPL_LRU, 1, core_clock);
+			sys->dtlb[i] = cache_new(cfg->dtlb_entries, cfg->dtlb_assoc, 1, CACHE_REPL_LRU, 1, core_clock);
+		}
+		sys->l2tlb = cache_new(cfg->l2tlb_entries, cfg->l2tlb_assoc, 1, CACHE_REPL_LRU, num_cores, par ? parsim_shared_clock(par) : clock);
 	}
 
 	return sys;
 }
 
+////////////////////////////////////////////////////////////////////
+// Free the caches, victim caches, TLBs and DRAM. A shared level's cache
+// and victim cache are every core's, so they are freed once.
+////////////////////////////////////////////////////////////////////
+
+void memsys_free(Memsys* sys){
+	for (uint64_t k=0; k<sys->num_caches; k++) {
+		Cache* c = sys->caches[k].c;
+		if (c->sdprof) {
+			sdprof_free(c->sdprof);
+		}
+		if (c->prefetcher) {
+			prefetch_free(c->prefetcher);
+		}
+		if (c->mshr) {
+			mshr_delete(c->mshr);
+		}
+		free(c->stat_set_misses);
+		free(sys->caches[k].header);
+		cache_free(c);
+	}
+	free(sys->caches);
+
+	uint64_t num_cores = sys->cfg->num_cores;
+	for (uint64_t k=0; k<sys->num_levels; k++) {
+		Memsys_Level* l = &sys->level[k];
+		if (l->victim) {
+			for (uint64_t i=0; i < (l->cfg->shared ? 1 : num_cores); i++) {
+				cache_free(l->victim[i]);
+			}
+			free(l->victim);
+		}
+		free(l->cache);
+	}
+
+	if (sys->l2tlb) {
+		for (uint64_t i=0; i<num_cores; i++) {
+			cache_free(sys->itlb[i]);
+			cache_free(sys->dtlb[i]);
+		}
+		free(sys->itlb);
+		free(sys->dtlb);
+		cache_free(sys->l2tlb);
+	}
+
+	free(sys->dram);
+	if (sys->hier != sys->cfg->hier) {
+		free(sys->hier);
+	}
+	free(sys->core_stats);
+	free(sys->access_pc);
+	free(sys->fill_dirty);
+	free(sys->access_cycle);
+	free(sys->access_page_size);
+	free(sys);
+}
+
 
 ////////////////////////////////////////////////////////////////////
 // Return the latency of a memory operation
 ////////////////////////////////////////////////////////////////////
 
-uint64_t memsys_access(Memsys* sys, Addr addr, Access_Type type, uint32_t core_id){
+uint64_t memsys_access(Memsys* sys, Addr addr, Addr pc, Access_Type type, uint32_t core_id){
+	HOSTPROF_START(host_start);
 	uint32_t delay = 0;
+	sys->access_pc[core_id] = pc;
+	uint64_t cycle = *sys->level[0].cache[core_id]->clock;
+	sys->access_cycle[core_id] = cycle;
 
 	// all cache transactions happen at line granularity, so get lineaddr
-	Addr lineaddr = addr / CACHE_LINESIZE;
+	Addr lineaddr = addr / sys->cfg->cache_linesize;
 
-	switch (SIM_MODE) {
-		case SIM_MODE_A:
-			delay = memsys_access_modeA(sys,lineaddr,type,core_id);
-			break;
+	// the TLBs hold virtual page numbers
+	if (sys->l2tlb) {
+		delay = memsys_tlb_access(sys, lineaddr, type == ACCESS_TYPE_IFETCH, core_id);
+		sys->access_cycle[core_id] = cycle + delay;
+	}
 
-		case SIM_MODE_B:
-		case SIM_MODE_C:
-			delay = memsys_access_modeBC(sys,lineaddr,type,core_id);
-			break;
+	sys->access_page_size[core_id] = memsys_page_size(sys, addr);
 
-		case SIM_MODE_D:
-		case SIM_MODE_E:
-			delay = memsys_access_modeDE(sys,lineaddr,type,core_id);
-			break;
-		default:
-			break;
+	// Parts D,E give each core its own address space
+	if (sys->cfg->sim_mode == SIM_MODE_D || sys->cfg->sim_mode == SIM_MODE_E) {
+		lineaddr = memsys_translate(sys, lineaddr, core_id);
+	}
+
+	Memsys_Path* p = (type == ACCESS_TYPE_IFETCH) ? &sys->ipath : &sys->dpath;
+	delay += memsys_path_access(sys, p, 0, lineaddr, type == ACCESS_TYPE_STORE, false, core_id);
+
+	// Timing is not simulated in Part A
+	if (sys->cfg->sim_mode == SIM_MODE_A) {
+		delay = 0;
 	}
 
 	//update the stats
+	Memsys_Stats* st = &sys->core_stats[core_id];
 
 	switch (type) {
 		case ACCESS_TYPE_IFETCH: 
-			sys->stat_ifetch_access++;
-			sys->stat_ifetch_delay += delay;
+			st->stat_ifetch_access++;
+			st->stat_ifetch_delay += delay;
 			break;
 		case ACCESS_TYPE_LOAD:
-			sys->stat_load_access++;
-			sys->stat_load_delay += delay;
+			st->stat_load_access++;
+			st->stat_load_delay += delay;
 			break;
 		case ACCESS_TYPE_STORE:
-			sys->stat_store_access++;
-			sys->stat_store_delay += delay;
+			st->stat_store_access++;
+			st->stat_store_delay += delay;
 			break;
 		default:
 			break;
 	}
 
+	HOSTPROF_ADD(st->stat_host_ns, host_start);
 	return delay;
 }
 
 
 
 ////////////////////////////////////////////////////////////////////
+// Sum of the per-core stats
+////////////////////////////////////////////////////////////////////
+
+void memsys_total_stats(Memsys* sys, Memsys_Stats* total){
+	memset(total, 0, sizeof(Memsys_Stats));
+	for (uint64_t i=0; i<sys->cfg->num_cores; i++) {
+		Memsys_Stats* st = &sys->core_stats[i];
+		total->stat_ifetch_access += st->stat_ifetch_access;
+		total->stat_load_access   += st->stat_load_access;
+		total->stat_store_access  += st->stat_store_access;
+		total->stat_ifetch_delay  += st->stat_ifetch_delay;
+		total->stat_load_delay    += st->stat_load_delay;
+		total->stat_store_delay   += st->stat_store_delay;
+		total->stat_host_ns       += st->stat_host_ns;
+		total->stat_walks         += st->stat_walks;
+		total->stat_walk_cycles   += st->stat_walk_cycles;
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+// Distinct lines held at the end of the run by the cache and the
+// caches above it that can fill from it, victim caches included: an inclusive level adds no
+// capacity to the caches above, an exclusive one all of its own
+////////////////////////////////////////////////////////////////////
+
+static void memsys_valid_lines(Cache* c, std::unordered_set<Addr>* lines){
+	Addr* buf = (Addr*)malloc(c->number_sets * c->number_ways * sizeof(Addr));
+	uint64_t n = cache_valid_lines(c, buf);
+	lines->insert(buf, buf + n);
+	free(buf);
+}
+
+static uint64_t memsys_effective_lines(Memsys* sys, Memsys_Cache* mc){
+	std::unordered_set<Addr> lines;
+	Memsys_Level* l = mc->level;
+
+	memsys_valid_lines(mc->c, &lines);
+	if (l->victim) {
+		memsys_valid_lines(l->victim[mc->core_id], &lines);
+	}
+
+	for (uint64_t j=0; j<l->num_above; j++) {
+		Memsys_Level* a = l->above[j];
+		for (uint64_t i=0; i<sys->cfg->num_cores; i++) {
+			if (!l->cfg->shared && i != mc->core_id) {
+				continue;
+			}
+			memsys_valid_lines(a->cache[i], &lines);
+			if (a->victim) {
+				memsys_valid_lines(a->victim[i], &lines);
+			}
+			if (a->cfg->shared) {
+				break;
+			}
+		}
+	}
+	return lines.size();
+}
+
+////////////////////////////////////////////////////////////////////
+// Cache stats, followed by the inclusion stats, the victim cache, the
+// MSHRs, the UCP partitions, the prefetcher and the miss-ratio curve
+// when profiling
 ////////////////////////////////////////////////////////////////////
 
-void memsys_print_stats(Memsys* sys){
+// Every demand miss of the cache probes its victim cache
+static void memsys_print_victim(Cache* vc, char* header, FILE* out){
+	uint64_t probes = vc->stat_read_access;
+	uint64_t hits = probes - vc->stat_read_miss;
+	double hit_perc = probes ? 100.0 * (double)hits / (double)probes : 0.0;
+	fprintf(out, "\n%s_VICTIM_PROBES  \t\t : %10llu", header, (unsigned long long)probes);
+	fprintf(out, "\n%s_VICTIM_HITS    \t\t : %10llu", header, (unsigned long long)hits);
+	fprintf(out, "\n%s_VICTIM_HIT_PERC\t\t : %10.3f", header, hit_perc);
+	fprintf(out, "\n%s_VICTIM_DIRTY_EVICTS\t : %10llu", header, (unsigned long long)vc->stat_dirty_evicts);
+	fprintf(out, "\n");
+}
+
+////////////////////////////////////////////////////////////////////
+// How evenly the demand misses spread over the sets, to compare page
+// sizes: the coefficient of variation of the misses per set, and the
+// share of the misses that fall in the eighth of the sets with most
+////////////////////////////////////////////////////////////////////
+
+static void memsys_print_set_misses(Cache* c, char* header, FILE* out){
+	uint64_t num_sets = c->number_sets;
+	uint64_t* misses = (uint64_t*)malloc(num_sets * sizeof(uint64_t));
+	memcpy(misses, c->stat_set_misses, num_sets * sizeof(uint64_t));
+	std::sort(misses, misses + num_sets, [](uint64_t a, uint64_t b){ return a > b; });
+
+	uint64_t total = 0, hot = 0;
+	uint64_t num_hot = (num_sets + 7) / 8;
+	for (uint64_t i=0; i<num_sets; i++) {
+		total += misses[i];
+		if (i < num_hot) {
+			hot += misses[i];
+		}
+	}
+	double cv = 0, hot_perc = 0;
+	if (total) {
+		double mean = (double)total / (double)num_sets;
+		double var = 0;
+		for (uint64_t i=0; i<num_sets; i++) {
+			var += ((double)misses[i] - mean) * ((double)misses[i] - mean);
+		}
+		cv = sqrt(var / (double)num_sets) / mean;
+		hot_perc = 100.0 * (double)hot / (double)total;
+	}
+	free(misses);
+
+	fprintf(out, "\n%s_SET_MISS_CV    \t\t : %10.3f", header, cv);
+	fprintf(out, "\n%s_HOT_SETS_MISS_PERC\t : %10.3f", header, hot_perc);
+	fprintf(out, "\n");
+}
+
+static void memsys_print_cache(Memsys* sys, Memsys_Cache* mc, uint64_t cycles, FILE* out, FILE* sdprof_csv){
+	Cache* c = mc->c;
+	char* header = mc->header;
+	cache_print_stats(c, header, out);
+
+	// the default (non-inclusive) hierarchies print what they always did
+	Memsys_Level* l = mc->level;
+	bool inclusion = l->num_above && l->cfg->inclusion != HIER_NON_INCLUSIVE;
+	if (inclusion) {
+		uint64_t effective_kb = memsys_effective_lines(sys, mc) * sys->cfg->cache_linesize / 1024;
+		fprintf(out, "\n%s_EFFECTIVE_KB   \t\t : %10llu", header, (unsigned long long)effective_kb);
+	}
+	if (inclusion && l->cfg->inclusion == HIER_INCLUSIVE) {
+		fprintf(out, "\n%s_BACK_INVALS    \t\t : %10llu", header, (unsigned long long)c->stat_back_invals);
+		fprintf(out, "\n%s_BACK_INVALS_DIRTY\t : %10llu", header, (unsigned long long)c->stat_back_invals_dirty);
+	}
+	if (l->below_inclusive) {
+		fprintf(out, "\n%s_INCLUSION_VICTIMS\t : %10llu", header, (unsigned long long)c->stat_inclusion_victims);
+	}
+	if (l->cfg->write_through || !l->cfg->write_allocate) {
+		fprintf(out, "\n%s_WRITES_DOWN    \t\t : %10llu", header, (unsigned long long)c->stat_writes_down);
+	}
+	if (inclusion || l->below_inclusive || l->cfg->write_through || !l->cfg->write_allocate) {
+		fprintf(out, "\n");
+	}
+
+	if (c->stat_set_misses) {
+		memsys_print_set_misses(c, header, out);
+	}
+
+	if (l->victim) {
+		memsys_print_victim(l->victim[mc->core_id], header, out);
+	}
+
+	if (c->mshr) {
+		mshr_print_stats(c->mshr, header, cycles, out);
+	}
+
+	if (c->utility_monitor_struct) {
+		cache_print_ucp_stats(c, header, out);
+	}
+
+	if (c->prefetcher) {
+		prefetch_print_stats(c->prefetcher, header, c->stat_read_miss + c->stat_write_miss, out);
+	}
+
+	if (c->sdprof) {
+		sdprof_print_stats(c->sdprof, header, out);
+		if (sdprof_csv) {
+			sdprof_write_csv(c->sdprof, header, sdprof_csv);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+// TLB misses per thousand instructions (one instruction fetch each),
+// then the page walks of every core
+////////////////////////////////////////////////////////////////////
+
+static void memsys_print_tlb(Cache* t, const char* header, uint64_t inst, FILE* out){
+	double mpki = inst ? 1000.0 * (double)t->stat_read_miss / (double)inst : 0;
+	fprintf(out, "\n%s_ACCESS         \t\t : %10llu", header, (unsigned long long)t->stat_read_access);
+	fprintf(out, "\n%s_MISS           \t\t : %10llu", header, (unsigned long long)t->stat_read_miss);
+	fprintf(out, "\n%s_MPKI           \t\t : %10.3f", header, mpki);
+}
+
+static void memsys_print_tlbs(Memsys* sys, FILE* out){
+	char header[256];
+	Memsys_Stats total;
+	memsys_total_stats(sys, &total);
+
+	for (uint64_t i=0; i<sys->cfg->num_cores; i++) {
+		Memsys_Stats* st = &sys->core_stats[i];
+		double avg_walk = st->stat_walks ? (double)st->stat_walk_cycles / (double)st->stat_walks : 0;
+
+		fprintf(out, "\n");
+		snprintf(header, sizeof(header), "ITLB_%llu", (unsigned long long)i);
+		memsys_print_tlb(sys->itlb[i], header, st->stat_ifetch_access, out);
+		snprintf(header, sizeof(header), "DTLB_%llu", (unsigned long long)i);
+		memsys_print_tlb(sys->dtlb[i], header, st->stat_ifetch_access, out);
+		snprintf(header, sizeof(header), "WALK_%llu", (unsigned long long)i);
+		fprintf(out, "\n%s_COUNT          \t\t : %10llu", header, (unsigned long long)st->stat_walks);
+		fprintf(out, "\n%s_CYCLES         \t\t : %10llu", header, (unsigned long long)st->stat_walk_cycles);
+		fprintf(out, "\n%s_AVG_CYCLES     \t\t : %10.3f", header, avg_walk);
+	}
+	fprintf(out, "\n");
+	memsys_print_tlb(sys->l2tlb, "L2TLB", total.stat_ifetch_access, out);
+	fprintf(out, "\n");
+}
+
+////////////////////////////////////////////////////////////////////
+// cycles is the length of the run: with the parallel engine a core's
+// clock stops wherever the core finished, or jumps past it
+////////////////////////////////////////////////////////////////////
+
+void memsys_print_stats(Memsys* sys, uint64_t cycles, FILE* out){
 	char header[256];
 	sprintf(header, "MEMSYS");
 
+	Memsys_Stats total;
+	memsys_total_stats(sys, &total);
+
 	double ifetch_delay_avg=0, load_delay_avg=0, store_delay_avg=0;
 
-	if (sys->stat_ifetch_access) {
-		ifetch_delay_avg = (double)(sys->stat_ifetch_delay) / (double)(sys->stat_ifetch_access);
+	if (total.stat_ifetch_access) {
+		ifetch_delay_avg = (double)(total.stat_ifetch_delay) / (double)(total.stat_ifetch_access);
 	}
 
-	if (sys->stat_load_access) {
-		load_delay_avg = (double)(sys->stat_load_delay) / (double)(sys->stat_load_access);
+	if (total.stat_load_access) {
+		load_delay_avg = (double)(total.stat_load_delay) / (double)(total.stat_load_access);
 	}
 
-	if (sys->stat_store_access) {
-		store_delay_avg = (double)(sys->stat_store_delay) / (double)(sys->stat_store_access);
+	if (total.stat_store_access) {
+		store_delay_avg = (double)(total.stat_store_delay) / (double)(total.stat_store_access);
 	}
 
 
-	printf("\n");
-	printf("\n%s_IFETCH_ACCESS  \t\t : %10llu",  header, sys->stat_ifetch_access);
-	printf("\n%s_LOAD_ACCESS    \t\t : %10llu",  header, sys->stat_load_access);
-	printf("\n%s_STORE_ACCESS   \t\t : %10llu",  header, sys->stat_store_access);
-	printf("\n%s_IFETCH_AVGDELAY\t\t : %10.3f",  header, ifetch_delay_avg);
-	printf("\n%s_LOAD_AVGDELAY  \t\t : %10.3f",  header, load_delay_avg);
-	printf("\n%s_STORE_AVGDELAY \t\t : %10.3f",  header, store_delay_avg);
-	printf("\n");
+	fprintf(out, "\n");
+	fprintf(out, "\n%s_IFETCH_ACCESS  \t\t : %10llu",  header, total.stat_ifetch_access);
+	fprintf(out, "\n%s_LOAD_ACCESS    \t\t : %10llu",  header, total.stat_load_access);
+	fprintf(out, "\n%s_STORE_ACCESS   \t\t : %10llu",  header, total.stat_store_access);
+	fprintf(out, "\n%s_IFETCH_AVGDELAY\t\t : %10.3f",  header, ifetch_delay_avg);
+	fprintf(out, "\n%s_LOAD_AVGDELAY  \t\t : %10.3f",  header, load_delay_avg);
+	fprintf(out, "\n%s_STORE_AVGDELAY \t\t : %10.3f",  header, store_delay_avg);
+	fprintf(out, "\n");
 
-	switch (SIM_MODE) {
-		case SIM_MODE_A:
-			sprintf(header, "DCACHE");
-			cache_print_stats(sys->dcache, header);
-			break;
-		case SIM_MODE_B:
-		case SIM_MODE_C:
-			sprintf(header, "ICACHE");
-			cache_print_stats(sys->icache, header);
-			sprintf(header, "DCACHE");
-			cache_print_stats(sys->dcache, header);
-			sprintf(header, "L2CACHE");
-			cache_print_stats(sys->l2cache, header);
-			dram_print_stats(sys->dram);
-			break;
+	FILE* sdprof_csv = NULL;
+	if (sys->cfg->sdprof_csv) {
+		if ((sdprof_csv = fopen(sys->cfg->sdprof_csv, "w")) == NULL) {
+			die_message("Unable to create the -sdprof_csv file");
+		}
+		fprintf(sdprof_csv, "cache,sets,assoc,size_bytes,accesses,miss_perc\n");
+	}
 
-		case SIM_MODE_D:
-		case SIM_MODE_E:
-			assert(NUM_CORES==2); //Hardcoded
-			sprintf(header, "ICACHE_0");
-			cache_print_stats(sys->icache_coreid[0], header);
-			sprintf(header, "DCACHE_0");
-			cache_print_stats(sys->dcache_coreid[0], header);
-			sprintf(header, "ICACHE_1");
-			cache_print_stats(sys->icache_coreid[1], header);
-			sprintf(header, "DCACHE_1");
-			cache_print_stats(sys->dcache_coreid[1], header);
-			sprintf(header, "L2CACHE");
-			cache_print_stats(sys->l2cache, header);
-			dram_print_stats(sys->dram);
-			break;
-		default:
-			break;
+	for (uint64_t k=0; k<sys->num_caches; k++) {
+		memsys_print_cache(sys, &sys->caches[k], cycles, out, sdprof_csv);
+	}
+	if (sys->l2tlb) {
+		memsys_print_tlbs(sys, out);
+	}
+	if (sys->dram) {
+		dram_print_stats(sys->dram, out);
+		if (sys->cfg->layout_stats) {
+			dram_print_rowbuf_stats(sys->dram, out);
+		}
+	}
+
+	if (sdprof_csv) {
+		fclose(sdprof_csv);
 	}
 }
 
 
 ////////////////////////////////////////////////////////////////////
-// Used by Part A to access the L1 cache
+// DRAM accesses are charged to the core they are made for, so the
+// prefetchers can tell how much DRAM traffic their fills caused
 ////////////////////////////////////////////////////////////////////
 
-uint64_t memsys_access_modeA(Memsys* sys, Addr lineaddr, Access_Type type, uint32_t core_id){
-  
-	// IFETCH accesses go to icache, which we don't have in part A
-	bool needs_dcache_access = !(type == ACCESS_TYPE_IFETCH);
+static uint64_t memsys_dram_access(Memsys* sys, Addr lineaddr, bool is_dram_write, uint32_t core_id){
+	Memsys_Stats* st = &sys->core_stats[core_id];
+	if (is_dram_write) {
+		st->stat_dram_writes++;
+	} else {
+		st->stat_dram_reads++;
+	}
+	return dram_access(sys->dram, lineaddr, is_dram_write);
+}
 
-	// Stores write to the caches
-	bool is_write = (type == ACCESS_TYPE_STORE);
+// Line address of the line the last cache_install() into c evicted
+static Addr memsys_evicted_lineaddr(Cache* c, Addr lineaddr){
+	return c->last_evicted_line.tag * c->number_sets + lineaddr % c->number_sets;
+}
 
-	if (needs_dcache_access) {
-		// Miss
-		if (!cache_access(sys->dcache,lineaddr,is_write,core_id)) {
-			// Install the new line in L1
-			cache_install(sys->dcache,lineaddr,is_write,core_id);
+// Prefetchers do not cross page boundaries: the next page may not be
+// mapped, or mapped anywhere. The page is that of the access the
+// prefetcher trained on; a large page maps onto a large physical frame.
+static bool memsys_same_page(Memsys* sys, Addr lineaddr, Addr other, uint32_t core_id){
+	uint64_t linesize = sys->cfg->cache_linesize;
+	uint64_t page_size = sys->access_page_size[core_id];
+	return (lineaddr * linesize) / page_size == (other * linesize) / page_size;
+}
+
+////////////////////////////////////////////////////////////////////
+// Level l of an inclusive hierarchy evicted the line: remove it from
+// every cache above (only core_id's if l is private). Returns whether a
+// removed copy was dirty, so the victim has to be written back.
+////////////////////////////////////////////////////////////////////
+
+static bool memsys_back_invalidate(Memsys* sys, Memsys_Level* l, Cache* c, Addr lineaddr, uint32_t core_id){
+	bool dirty = false;
+	for (uint64_t j=0; j<l->num_above; j++) {
+		Memsys_Level* a = l->above[j];
+		for (uint64_t i=0; i<sys->cfg->num_cores; i++) {
+			if (!l->cfg->shared && i != core_id) {
+				continue;
+			}
+			Cache* u = a->cache[i];
+			uint32_t meta = cache_invalidate(u, lineaddr);
+			if (a->victim) {
+				meta |= cache_invalidate(a->victim[i], lineaddr);
+			}
+			if (meta & CACHE_META_VALID) {
+				c->stat_back_invals++;
+				u->stat_inclusion_victims++;
+			}
+			if (meta & CACHE_META_DIRTY) {
+				c->stat_back_invals_dirty++;
+				dirty = true;
+			}
+			if (a->cfg->shared) {
+				break;
+			}
 		}
 	}
+	return dirty;
+}
 
-	// Timing is not simulated in Part A
-	return 0;
-}
-
-////////////////////////////////////////////////////////////////////
-// Used by Parts B,C to access the L1 icache + L1 dcache
-// Returns the access latency
-////////////////////////////////////////////////////////////////////
-
-uint64_t memsys_access_modeBC(Memsys* sys, Addr lineaddr, Access_Type type, uint32_t core_id){
-	uint64_t delay;
-	//Initialize delay to zero
-	delay = 0;
-
-	// Perform the icache/dcache access
-	bool needs_icache_access = (type == ACCESS_TYPE_IFETCH);
-	bool needs_dcache_access = !(type == ACCESS_TYPE_IFETCH);
-
-	//Check Instruction Cache
-	if(needs_icache_access)
-	{
-		//if instruction cache hit
-		//Instruction Cache hit latency is 1
-		//store is not used 
-		bool is_write = false;
-		if(cache_access(sys->icache, lineaddr, is_write, core_id))
-		{
-			delay = ICACHE_HIT_LATENCY;
-		}
-		//Instruction cache is a miss
-		else
-		{
-			//Delay for accessing l2 
-			uint64_t l2_access_delay = memsys_L2_access(sys, lineaddr, is_write, core_id);
-			//Delay is the instruction cache latency plus the latency of l2 access
-			delay = ICACHE_HIT_LATENCY + l2_access_delay; 
-
-			//Install cache instruction 
-			cache_install(sys->icache, lineaddr, is_write, core_id);
-		}
-	
-	}
-
-	if(needs_dcache_access)
-	{
-		bool is_write;
-		if(type == ACCESS_TYPE_STORE)
-		{
-			is_write = true;
-		}
-		if(type == ACCESS_TYPE_LOAD)
-		{
-			is_write = false;
-		}
-		//Data cache hit
-		if(cache_access(sys->dcache, lineaddr, is_write, core_id))
-		{
-			delay = DCACHE_HIT_LATENCY;
-		}
-		// On dcache miss, access the L2 + install the new line + if needed, perform writeback
-		else
-		{
-			bool is_writeback = false;
-			//Delay for accessing l2 
-			uint64_t l2_access_delay = memsys_L2_access(sys, lineaddr, is_writeback, core_id);
-			//Delay is the data cache latency plus the latency of l2 access
-			delay = DCACHE_HIT_LATENCY + l2_access_delay; 
-
-			//Install data instruction 
-			cache_install(sys->dcache, lineaddr, is_write, core_id);
-
-			//if the last cache line has been evicted and it is dirty, writeback
-			if(sys->dcache->last_evicted_line.dirty == true)
-			{
-				//uint64_t cache_tag = lineaddr / c->number_sets;
-				//uint64_t cache_index = (lineaddr % c->number_sets);
-
-				//Line address is tag and index with out the offset 
-				bool is_writeback = true; 
-				uint64_t last_evicted_line_address;
-				uint64_t last_evicted_line_tag = sys->dcache->last_evicted_line.tag;
-				uint64_t last_evicted_line_number_sets = sys->dcache->number_sets;
-				uint64_t last_evicted_line_index = lineaddr % sys->dcache->number_sets;
-
-				uint64_t last_evicted_line_tag_bits  = last_evicted_line_tag * last_evicted_line_number_sets;
-
-				last_evicted_line_address = last_evicted_line_tag_bits + last_evicted_line_index; 
-
-				//Write the last_evicted_line to L2
-				memsys_L2_access(sys, last_evicted_line_address , is_writeback, core_id);
-			}
+static bool memsys_path_exclusive(Memsys_Path* p, uint64_t k){
+	return k < p->num_levels && p->level[k]->cfg->inclusion == HIER_EXCLUSIVE;
+}
+
+// Does a level above k on the path hold the line for core_id
+static bool memsys_path_held_above(Memsys_Path* p, uint64_t k, Addr lineaddr, uint32_t core_id){
+	for (uint64_t j=0; j<k; j++) {
+		Memsys_Level* a = p->level[j];
+		if (cache_probe(a->cache[core_id], lineaddr, core_id) ||
+		    (a->victim && cache_probe(a->victim[core_id], lineaddr, core_id))) {
+			return true;
 		}
 	}
-	
+	return false;
+}
 
-	return delay;
+////////////////////////////////////////////////////////////////////
+// Install the line in level k of a path and hand the victim to the
+// level below (through the level's victim cache, if it has one): dirty
+// victims are written back, and an exclusive level below takes clean
+// ones too. Nobody waits for that.
+////////////////////////////////////////////////////////////////////
+
+static void memsys_install(Memsys* sys, Memsys_Path* p, uint64_t k, Addr lineaddr, bool dirty, uint32_t core_id){
+	Memsys_Level* l = p->level[k];
+	Cache* c = l->cache[core_id];
+
+	cache_install(c, lineaddr, dirty, core_id);
+	if (!c->last_evicted_line.valid) {
+		return;
+	}
+	Addr victim_lineaddr = memsys_evicted_lineaddr(c, lineaddr);
+	bool victim_dirty = c->last_evicted_line.dirty;
+
+	// the victim cache takes the line, and hands on its own victim instead
+	if (l->victim) {
+		Cache* vc = l->victim[core_id];
+		cache_install(vc, victim_lineaddr, victim_dirty, core_id);
+		if (!vc->last_evicted_line.valid) {
+			return;
+		}
+		victim_lineaddr = memsys_evicted_lineaddr(vc, victim_lineaddr);
+		victim_dirty = vc->last_evicted_line.dirty;
+	}
+
+	if (l->cfg->inclusion == HIER_INCLUSIVE && l->num_above) {
+		victim_dirty |= memsys_back_invalidate(sys, l, c, victim_lineaddr, core_id);
+	}
+	if (victim_dirty || memsys_path_exclusive(p, k+1)) {
+		memsys_path_access(sys, p, k+1, victim_lineaddr, victim_dirty, true, core_id);
+	}
 }
 
 ////////////////////////////////////////////////////////////////////
-// Used by Parts B,C to access the L2
-// Returns the access latency
+// After a demand access to a cache: train its prefetcher and fill the
+// candidates the cache does not hold from the levels below, each in an
+// MSHR of its own if the cache has them (none free: dropped). An
+// exclusive level skips the lines the levels above hold. The access's
+// fill_dirty, on its way up, is left as it was. Returns the cycles a
+// hit on a prefetched line had to wait for its fill.
 ////////////////////////////////////////////////////////////////////
 
-uint64_t memsys_L2_access(Memsys* sys, Addr lineaddr, bool is_writeback, uint32_t core_id){ 
-	uint64_t delay = L2CACHE_HIT_LATENCY;
-	//L2 cache is a hit
-	if(cache_access(sys->l2cache, lineaddr, is_writeback, core_id))
-	{
-		delay = L2CACHE_HIT_LATENCY;
+static uint64_t memsys_prefetch(Memsys* sys, Memsys_Path* p, uint64_t k, Addr lineaddr, bool hit, uint64_t cycle, uint32_t core_id){
+	Memsys_Level* l = p->level[k];
+	Cache* c = l->cache[core_id];
+	Prefetcher* pf = c->prefetcher;
+	Memsys_Stats* st = &sys->core_stats[core_id];
+	// the fill's ready cycle, as the MSHR's, is counted from the level's
+	// access cycle, which is past the clock below the L1
+	uint64_t wait = 0;
+	if (hit && c->last_hit_prefetch) {
+		wait = cache_prefetch_hit(c, cycle);
 	}
-	//L2 cache is a miss
-	else
-	{
-		if(is_writeback == false)
-		{
-			bool is_dram_write = false;
-			//Delay for accessing l2 
-			uint64_t dram_access_delay = dram_access(sys->dram, lineaddr, is_dram_write);
-			//Delay is the dram latency plus the latency of l2 hit
-			delay = L2CACHE_HIT_LATENCY + dram_access_delay; 
 
-			//Install into L2 cache
-			cache_install(sys->l2cache, lineaddr, is_writeback, core_id);
+	// a shared cache: keep the cores' instructions apart in the stride table
+	Addr pc = sys->access_pc[core_id];
+	if (l->cfg->shared) {
+		pc ^= ((Addr)core_id << 56);
+	}
+	bool exclusive = (l->cfg->inclusion == HIER_EXCLUSIVE);
+	bool fill_dirty = sys->fill_dirty[core_id];
+	uint64_t n = prefetch_train(pf, lineaddr, pc, !hit || c->last_hit_prefetch);
+	for (uint64_t i=0; i<n; i++) {
+		Addr pf_lineaddr = pf->candidates[i];
+		if (!memsys_same_page(sys, lineaddr, pf_lineaddr, core_id) || cache_probe(c, pf_lineaddr, core_id) ||
+		    (l->victim && cache_probe(l->victim[core_id], pf_lineaddr, core_id)) ||
+		    (exclusive && memsys_path_held_above(p, k, pf_lineaddr, core_id))) {
+			continue;
+		}
+		if (c->mshr && !mshr_free(c->mshr, cycle)) {
+			c->mshr->stat_prefetch_drops++;
+			continue;
 		}
-		else
-		{
-			//Just want to install the line
-			delay = L2CACHE_HIT_LATENCY; 
-			//Install into L2 cache
-			cache_install(sys->l2cache, lineaddr, is_writeback, core_id);
+		uint64_t dram_reads = st->stat_dram_reads;
+		uint64_t dram_writes = st->stat_dram_writes;
+
+		sys->fill_dirty[core_id] = false;
+		sys->access_cycle[core_id] = cycle + l->cfg->latency;
+		uint64_t latency = l->cfg->latency + memsys_path_access(sys, p, k+1, pf_lineaddr, false, false, core_id);
+		memsys_install(sys, p, k, pf_lineaddr, sys->fill_dirty[core_id], core_id);
+		cache_mark_prefetch(c, pf_lineaddr, core_id, cycle + latency);
+		if (c->mshr) {
+			mshr_alloc(c->mshr, pf_lineaddr, cycle, cycle + latency);
 		}
 
-		//if the last cache line has been evicted and it is dirty 
-		if(sys->l2cache->last_evicted_line.dirty == true)
-		{
-			bool is_dram_write = true;
-			//uint64_t cache_tag = lineaddr / c->number_sets;
-			//uint64_t cache_index = (lineaddr % c->number_sets);
+		pf->stat_issued++;
+		pf->stat_dram_reads += st->stat_dram_reads - dram_reads;
+		pf->stat_dram_writes += st->stat_dram_writes - dram_writes;
+	}
+	sys->fill_dirty[core_id] = fill_dirty;
+	return wait;
+}
 
-			//Line address is tag and index with out the offset
-			//figure out the last_evicted_line_address 
-			uint64_t last_evicted_line_address;
-			uint64_t last_evicted_line_tag = sys->l2cache->last_evicted_line.tag;
-			uint64_t last_evicted_line_number_sets = sys->l2cache->number_sets;
-			uint64_t last_evicted_line_index = lineaddr % sys->l2cache->number_sets;
+////////////////////////////////////////////////////////////////////
+// Level k of a path. A miss reads the line from the level below, or
+// from the level's victim cache, and installs it (see
+// memsys_install()). A writeback that misses installs the line without
+// reading it. An exclusive level that fills the level above does not
+// keep the line: a hit hands it up, dirty or not, in fill_dirty.
+// With MSHRs, a demand access that hits a line still being filled
+// waits for the rest of the fill, and a miss waits for a free MSHR
+// first. A write-through level, and a no-write-allocate one that misses
+// a store, pass the write on without waiting for it. Returns the access
+// latency.
+////////////////////////////////////////////////////////////////////
 
-			uint64_t last_evicted_line_tag_bits  = last_evicted_line_tag * last_evicted_line_number_sets;
+static uint64_t memsys_level_access(Memsys* sys, Memsys_Path* p, uint64_t k, Addr lineaddr, bool is_write, bool is_writeback, uint32_t core_id){
+	Memsys_Level* l = p->level[k];
+	Cache* c = l->cache[core_id];
+	uint64_t delay = l->cfg->latency;
+	uint64_t wait = 0;
+	uint64_t cycle = sys->access_cycle[core_id];
+	bool pass_up = (l->cfg->inclusion == HIER_EXCLUSIVE) && k > 0 && !is_writeback;
+
+	// a clean victim (only exclusive levels get them) is no access of its own
+	bool hit = (is_writeback && !is_write) ? cache_probe(c, lineaddr, core_id) : cache_access(c, lineaddr, is_write, core_id);
+	if (hit && c->mshr && !is_writeback) {
+		wait = mshr_merge(c->mshr, lineaddr, cycle);
+	}
+	if (hit && pass_up) {
+		sys->fill_dirty[core_id] = (cache_invalidate(c, lineaddr) & CACHE_META_DIRTY) != 0;
+	}
+	if (hit && is_write && l->cfg->write_through) {
+		cache_clean(c, lineaddr);
+	}
 
-			last_evicted_line_address = last_evicted_line_tag_bits + last_evicted_line_index; 
+	// writes the level does not keep to itself go on to the level below
+	bool write_down = is_write && l->cfg->write_through;
 
-			//Write the last_evicted_line to dram
-			dram_access(sys->dram, last_evicted_line_address, is_dram_write);
+	if (!hit) {
+		if (c->stat_set_misses && !is_writeback) {
+			c->stat_set_misses[lineaddr % c->number_sets]++;
+		}
+		bool dirty = is_write && !l->cfg->write_through;
+		// a victim cache hit swaps the line back in; it is looked up
+		// alongside the level below, so only a hit costs victim_latency.
+		// A writeback just merges with the line there.
+		bool victim_hit = false;
+		if (l->victim) {
+			Cache* vc = l->victim[core_id];
+			victim_hit = is_writeback ? cache_probe(vc, lineaddr, core_id) : cache_access(vc, lineaddr, false, core_id);
+			if (victim_hit) {
+				dirty |= (cache_invalidate(vc, lineaddr) & CACHE_META_DIRTY) != 0;
+				delay += is_writeback ? 0 : l->cfg->victim_latency;
+			}
 		}
+		// no-write-allocate: a store that misses leaves the level alone
+		bool allocate = victim_hit || is_writeback || !is_write || l->cfg->write_allocate;
+		write_down |= !allocate;
+		if (allocate && !is_writeback && !victim_hit) {
+			uint64_t stall = c->mshr ? mshr_stall(c->mshr, cycle) : 0;
+			delay += stall;
+			sys->fill_dirty[core_id] = false;
+			sys->access_cycle[core_id] = cycle + delay;
+			delay += memsys_path_access(sys, p, k+1, lineaddr, false, false, core_id);
+			dirty |= sys->fill_dirty[core_id];
+			if (c->mshr) {
+				mshr_alloc(c->mshr, lineaddr, cycle + stall, cycle + delay);
+			}
+		}
+		if (!pass_up && allocate) {
+			memsys_install(sys, p, k, lineaddr, dirty, core_id);
+			sys->fill_dirty[core_id] = false;
+		}
+	}
+
+	if (write_down) {
+		c->stat_writes_down++;
+		sys->access_cycle[core_id] = cycle + l->cfg->latency;
+		memsys_path_access(sys, p, k+1, lineaddr, true, is_writeback, core_id);
+	}
+
+	// a prefetched line still in flight has its MSHR too, wait only once
+	if (c->prefetcher && !is_writeback) {
+		uint64_t pf_wait = memsys_prefetch(sys, p, k, lineaddr, hit, cycle, core_id);
+		wait = (pf_wait > wait) ? pf_wait : wait;
+	}
+	return delay + wait;
+}
+
+////////////////////////////////////////////////////////////////////
+// Level k of a path and everything below it; past the last level is
+// DRAM (none in Part A). The shared levels and DRAM are entered from
+// the last private level: with the parallel engine, that is where a
+// core waits for its turn.
+////////////////////////////////////////////////////////////////////
+
+static bool memsys_path_shared(Memsys_Path* p, uint64_t k){
+	return k == p->num_levels || p->level[k]->cfg->shared;
+}
+
+static uint64_t memsys_path_access(Memsys* sys, Memsys_Path* p, uint64_t k, Addr lineaddr, bool is_write, bool is_writeback, uint32_t core_id){
+	bool enter = sys->par && memsys_path_shared(p, k) && (k == 0 || !memsys_path_shared(p, k-1));
+	if (enter) {
+		parsim_shared_enter(sys->par, core_id);
+	}
+
+	uint64_t delay = 0;
+	if (k < p->num_levels) {
+		delay = memsys_level_access(sys, p, k, lineaddr, is_write, is_writeback, core_id);
+	}
+	else if (sys->dram) {
+		delay = memsys_dram_access(sys, lineaddr, is_write || is_writeback, core_id);
+	}
+
+	if (enter) {
+		parsim_shared_exit(sys->par, core_id);
 	}
 	return delay;
 }
@@ -370,200 +880,130 @@ uint64_t memsys_L2_access(Memsys* sys, Addr lineaddr, bool is_writeback, uint32_
 
 ////////////////////////////////////////////////////////////////////
 // ------------- DO NOT CHANGE THE CODE OF THIS FUNCTION ----------
+// The frame is tail + ((core_id + head) << 21), so core c's head-h
+// pages share their frames with core c+1's head-(h-1) pages: the cores'
+// address spaces are apart only while every trace stays in head 0
+// (its first 4GB of virtual memory). It no longer asserts exactly two
+// cores.
 ////////////////////////////////////////////////////////////////////
 
 uint64_t memsys_convert_vpn_to_pfn(Memsys *sys, uint64_t vpn, uint32_t core_id){
 	uint64_t tail = vpn & 0x000fffff;
 	uint64_t head = vpn >> 20;
-	uint64_t pfn  = tail + (core_id << 21) + (head << 21); 
-	assert(NUM_CORES==2);
+	uint64_t pfn  = tail + ((uint64_t)core_id << 21) + (head << 21); 
+	assert(core_id < sys->cfg->num_cores);
 	return pfn;
 }
 
+////////////////////////////////////////////////////////////////////
+// Virtual to physical line address, for Parts D,E. A 2MB page is the
+// run of 4KB frames memsys_convert_vpn_to_pfn() gives its first 4KB
+// page; that frame is 2MB-aligned, as the page is.
+////////////////////////////////////////////////////////////////////
 
-/////////////////////////////////////////////////////////////////////
-// Used by Parts D,E to access per-core L1 icache + L1 dcache
-/////////////////////////////////////////////////////////////////////
+static Addr memsys_translate(Memsys* sys, Addr v_lineaddr, uint32_t core_id){
+	uint64_t cache_linesize = sys->cfg->cache_linesize;
+	uint64_t addr = cache_linesize * v_lineaddr;
+	uint64_t page_size = sys->access_page_size[core_id];
+	uint64_t first_vpn = (addr / page_size) * (page_size / PAGE_SIZE);
+	uint64_t physical_frame_number = memsys_convert_vpn_to_pfn(sys, first_vpn, core_id);
+	uint64_t physical_address = physical_frame_number * PAGE_SIZE + addr % page_size;
+	return physical_address / cache_linesize;
+}
 
-uint64_t memsys_access_modeDE(Memsys* sys, Addr v_lineaddr, Access_Type type, uint32_t core_id){
-	//uint64_t delay;
+////////////////////////////////////////////////////////////////////
+// Page size of a virtual address: 2MB in the -huge_pages regions,
+// -page_sizeKB everywhere else
+////////////////////////////////////////////////////////////////////
 
-	// First convert lineaddr from virtual (v) to physical (p) using the
-	// function memsys_convert_vpn_to_pfn(). Page size is defined to be 4KB.
-	// NOTE: VPN_to_PFN operates at page granularity and returns page addr
+static uint64_t memsys_page_size(Memsys* sys, Addr addr){
+	Sim_Config* cfg = sys->cfg;
+	for (uint64_t i=0; i<cfg->num_huge_regions; i++) {
+		if (addr >= cfg->huge_page_start[i] && addr < cfg->huge_page_end[i]) {
+			return HUGE_PAGE_SIZE;
+		}
+	}
+	return cfg->page_size;
+}
 
-	//return delay;
+////////////////////////////////////////////////////////////////////
+// Page walks. Each core has a four-level page table with 512 entries of
+// 8 bytes per 4KB table, as x86-64. The tables live in physical memory
+// of their own above MEMSYS_PT_BASE_PFN, one per core, level and
+// page-number prefix, so the tables of neighbouring pages are
+// neighbours too. The walk loads one entry per level, each after the
+// last, through the data caches; a 2MB page ends at level 2.
+////////////////////////////////////////////////////////////////////
 
-	//Virtual Page Address is Virtual Page Number + Offset
+#define MEMSYS_PT_LEVELS      4
+#define MEMSYS_PT_INDEX_BITS  9
+#define MEMSYS_PT_BASE_PFN    (1ULL << 40)
 
-	//uint64_t number_of_sets = c->number_sets;
-	//uint64_t cache_index = (lineaddr % number_of_sets);
-	//uint64_t cache_tag = lineaddr / number_of_sets;
-	//Lineaddr = tag + index
-	//Lineaddr = addr /CACHE_LINESIZE
-	// addr = CACHE_LINESIZE * Lineaddr
-	//Line address mode page size
+static Addr memsys_pt_pfn(uint32_t core_id, uint64_t level, uint64_t prefix){
+	return MEMSYS_PT_BASE_PFN + ((Addr)core_id << 32) + ((level-1) << 28) + (prefix & ((1ULL << 28) - 1));
+}
 
-	uint64_t cache_linesize = CACHE_LINESIZE;
-	uint64_t page_size = PAGE_SIZE;
-	uint64_t icache_hit_latency = ICACHE_HIT_LATENCY;
-	uint64_t dcache_hit_latency = DCACHE_HIT_LATENCY;
-	//virtual_page_number = A/page_size
-	uint64_t addr = cache_linesize * v_lineaddr;
-	uint64_t virtual_page_number = addr / page_size;
-	uint64_t physical_frame_number;
-	physical_frame_number = memsys_convert_vpn_to_pfn(sys, virtual_page_number, core_id);
-	//offset = A mod page_size
-	uint64_t offset = addr % page_size;
-	uint64_t physical_page_number_bits = physical_frame_number * page_size;
-	uint64_t physical_address = physical_page_number_bits + offset;
-	//Lineaddr = addr /CACHE_LINESIZE
-	uint64_t physical_lineaddr = physical_address / cache_linesize;
-
-	uint64_t delay;
-	//Initialize delay to zero
-	delay = 0;
-
-	// Perform the icache/dcache access
-	bool needs_icache_access = (type == ACCESS_TYPE_IFETCH);
-	bool needs_dcache_access = !(type == ACCESS_TYPE_IFETCH);
-
-	//Check Instruction Cache
-	if(needs_icache_access)
-	{
-		//if instruction cache hit
-		//Instruction Cache hit latency is 1
-		//store is not used 
-		bool is_write = false;
-		if(cache_access(sys->icache_coreid[core_id], physical_lineaddr, is_write, core_id))
-		{
-			delay = icache_hit_latency;
-		}
-		//Instruction cache is a miss
-		else
-		{
-			//Delay for accessing l2 
-			uint64_t l2_access_delay = memsys_L2_access_multicore(sys, physical_lineaddr, is_write, core_id);
-			//Delay is the instruction cache latency plus the latency of l2 access
-			delay = icache_hit_latency + l2_access_delay; 
-
-			//Install cache instruction 
-			cache_install(sys->icache_coreid[core_id], physical_lineaddr, is_write, core_id);
-		}
-	
-	}
-
-	if(needs_dcache_access)
-	{
-		bool is_write;
-		if(type == ACCESS_TYPE_STORE)
-		{
-			is_write = true;
-		}
-		if(type == ACCESS_TYPE_LOAD)
-		{
-			is_write = false;
-		}
-		//Data cache hit
-		if(cache_access(sys->dcache_coreid[core_id], physical_lineaddr, is_write, core_id))
-		{
-			delay = dcache_hit_latency;
-		}
-		// On dcache miss, access the L2 + install the new line + if needed, perform writeback
-		else
-		{
-			bool is_writeback = false;
-			//Delay for accessing l2 
-			uint64_t l2_access_delay = memsys_L2_access_multicore(sys, physical_lineaddr, is_writeback, core_id);
-			//Delay is the data cache latency plus the latency of l2 access
-			delay = dcache_hit_latency + l2_access_delay; 
-
-			//Install data instruction 
-			cache_install(sys->dcache_coreid[core_id], physical_lineaddr, is_write, core_id);
-
-			//if the last cache line has been evicted and it is dirty, writeback
-			if(sys->dcache_coreid[core_id]->last_evicted_line.dirty == true)
-			{
-				//uint64_t cache_tag = lineaddr / c->number_sets;
-				//uint64_t cache_index = (lineaddr % c->number_sets);
-
-				//Line address is tag and index with out the offset 
-				bool is_writeback = true; 
-				uint64_t last_evicted_line_address;
-				uint64_t last_evicted_line_tag = sys->dcache_coreid[core_id]->last_evicted_line.tag;
-				uint64_t last_evicted_line_number_sets = sys->dcache_coreid[core_id]->number_sets;
-				uint64_t last_evicted_line_index = physical_lineaddr % sys->dcache_coreid[core_id]->number_sets;
-
-				uint64_t last_evicted_line_tag_bits  = last_evicted_line_tag * last_evicted_line_number_sets;
-
-				last_evicted_line_address = last_evicted_line_tag_bits + last_evicted_line_index; 
-
-				//Write the last_evicted_line to L2
-				memsys_L2_access_multicore(sys, last_evicted_line_address , is_writeback, core_id);
-			}
-		}
+static uint64_t memsys_walk(Memsys* sys, uint64_t vpn, uint64_t last_level, uint32_t core_id){
+	uint64_t cycle = sys->access_cycle[core_id];
+	uint64_t delay = 0;
+	sys->access_page_size[core_id] = PAGE_SIZE;
+	for (uint64_t level = MEMSYS_PT_LEVELS; level >= last_level; level--) {
+		uint64_t prefix = vpn >> (MEMSYS_PT_INDEX_BITS * level);
+		uint64_t index = (vpn >> (MEMSYS_PT_INDEX_BITS * (level-1))) & ((1 << MEMSYS_PT_INDEX_BITS) - 1);
+		Addr pte_addr = memsys_pt_pfn(core_id, level, prefix) * PAGE_SIZE + index * 8;
+
+		sys->access_cycle[core_id] = cycle + delay;
+		delay += memsys_path_access(sys, &sys->dpath, 0, pte_addr / sys->cfg->cache_linesize, false, false, core_id);
 	}
-	
-
 	return delay;
 }
 
+////////////////////////////////////////////////////////////////////
+// Look the page up in the core's ITLB or DTLB, then in the L2 TLB,
+// and walk the page table if both miss. An L1 TLB hit is free (it is
+// looked up alongside the L1 cache). Returns the cycles the translation
+// adds to the access.
+////////////////////////////////////////////////////////////////////
 
-/////////////////////////////////////////////////////////////////////
-// Used by Parts D,E to access the L2
-/////////////////////////////////////////////////////////////////////
+static uint64_t memsys_tlb_access(Memsys* sys, Addr v_lineaddr, bool is_ifetch, uint32_t core_id){
+	Addr addr = v_lineaddr * sys->cfg->cache_linesize;
+	uint64_t page_size = memsys_page_size(sys, addr);
+	bool huge = (page_size == HUGE_PAGE_SIZE);
+
+	// an entry maps a 4KB or a 2MB page, the low bit tells which
+	Addr page = ((addr / page_size) << 1) | huge;
+	Cache* l1tlb = is_ifetch ? sys->itlb[core_id] : sys->dtlb[core_id];
+	if (cache_access(l1tlb, page, false, 0)) {
+		return 0;
+	}
+
+	// the L2 TLB is shared: keep the cores' address spaces apart
+	Addr key = page ^ ((Addr)core_id << 48);
+	uint64_t delay = sys->cfg->l2tlb_latency;
+	if (sys->par) {
+		parsim_shared_enter(sys->par, core_id);
+	}
+	bool hit = cache_access(sys->l2tlb, key, false, core_id);
+	if (sys->par) {
+		parsim_shared_exit(sys->par, core_id);
+	}
 
-uint64_t memsys_L2_access_multicore(Memsys* sys, Addr lineaddr, bool is_writeback, uint32_t core_id){
-	uint64_t delay = L2CACHE_HIT_LATENCY;
-	//L2 cache is a hit
-	if(cache_access(sys->l2cache, lineaddr, is_writeback, core_id))
-	{
-		delay = L2CACHE_HIT_LATENCY;
-	}
-	//L2 cache is a miss
-	else
-	{
-		if(is_writeback == false)
-		{
-			bool is_dram_write = false;
-			//Delay for accessing l2 
-			uint64_t dram_access_delay = dram_access(sys->dram, lineaddr, is_dram_write);
-			//Delay is the dram latency plus the latency of l2 hit
-			delay = L2CACHE_HIT_LATENCY + dram_access_delay; 
-
-			//Install into L2 cache
-			cache_install(sys->l2cache, lineaddr, is_writeback, core_id);
-		}
-		else
-		{
-			//Just want to install the line
-			delay = L2CACHE_HIT_LATENCY; 
-			//Install into L2 cache
-			cache_install(sys->l2cache, lineaddr, is_writeback, core_id);
-		}
-
-		//if the last cache line has been evicted and it is dirty 
-		if(sys->l2cache->last_evicted_line.dirty == true)
-		{
-			bool is_dram_write = true;
-			//uint64_t cache_tag = lineaddr / c->number_sets;
-			//uint64_t cache_index = (lineaddr % c->number_sets);
-
-			//Line address is tag and index with out the offset
-			//figure out the last_evicted_line_address 
-			uint64_t last_evicted_line_address;
-			uint64_t last_evicted_line_tag = sys->l2cache->last_evicted_line.tag;
-			uint64_t last_evicted_line_number_sets = sys->l2cache->number_sets;
-			uint64_t last_evicted_line_index = lineaddr % sys->l2cache->number_sets;
-
-			uint64_t last_evicted_line_tag_bits  = last_evicted_line_tag * last_evicted_line_number_sets;
-
-			last_evicted_line_address = last_evicted_line_tag_bits + last_evicted_line_index; 
-
-			//Write the last_evicted_line to dram
-			dram_access(sys->dram, last_evicted_line_address, is_dram_write);
+	if (!hit) {
+		Memsys_Stats* st = &sys->core_stats[core_id];
+		sys->access_cycle[core_id] += delay;
+		uint64_t walk = memsys_walk(sys, addr / PAGE_SIZE, huge ? 2 : 1, core_id);
+		st->stat_walks++;
+		st->stat_walk_cycles += walk;
+		delay += walk;
+
+		if (sys->par) {
+			parsim_shared_enter(sys->par, core_id);
+		}
+		cache_install(sys->l2tlb, key, false, core_id);
+		if (sys->par) {
+			parsim_shared_exit(sys->par, core_id);
 		}
 	}
+	cache_install(l1tlb, page, false, 0);
 	return delay;
 }
-
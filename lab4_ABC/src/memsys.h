@@ -1,53 +1,119 @@
 #ifndef MEMSYS_H
 #define MEMSYS_H
 
+#include <stdio.h>
 #include <stdint.h>
 
 #include "types.h"
 #include "cache.h"
 #include "dram.h"
+#include "parsim.h"
+#include "hier.h"
 
 //////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////
 
+typedef struct Memsys_Stats Memsys_Stats;
+typedef struct Memsys_Level Memsys_Level;
+typedef struct Memsys_Path Memsys_Path;
+typedef struct Memsys_Cache Memsys_Cache;
 typedef struct Memsys Memsys;
 
-struct Memsys {
-	Cache* dcache;  // For Part A
-	Cache* icache;  // For Parts A,B,C
-
-	Cache* dcache_coreid[MAX_CORES];  // For Parts D,E
-	Cache* icache_coreid[MAX_CORES];  // For Parts D,E
-
-	Cache* l2cache; // For Parts A,B,C,D,E
-	DRAM* dram;    // For Parts C,D,E
-
-	// stats 
+// kept per core, so cores simulated on different host threads (see
+// parsim.h) never write the same counters
+struct alignas(64) Memsys_Stats {
 	unsigned long long stat_ifetch_access;
 	unsigned long long stat_load_access;
 	unsigned long long stat_store_access;
 	uint64_t stat_ifetch_delay;
 	uint64_t stat_load_delay;
 	uint64_t stat_store_delay;
+	uint64_t stat_host_ns;      // host time in memsys_access(), HOST_PROFILE builds only
+	uint64_t stat_dram_reads;   // DRAM accesses made for this core, so prefetches
+	uint64_t stat_dram_writes;  // can be charged their DRAM traffic
+	uint64_t stat_walks;        // -tlb: page walks, i.e. L2 TLB misses
+	uint64_t stat_walk_cycles;  // ... and the cycles they took
 };
 
+// One level of the hierarchy (see hier.h)
+struct Memsys_Level {
+	Hier_Level* cfg;
+	Cache** cache;          // per core; every core gets the same cache of a shared level
+	Cache** victim;         // its victim caches, laid out the same way; NULL if none
 
+	// the levels above it on any path, i.e. what its inclusion policy covers
+	Memsys_Level* above[HIER_MAX_LEVELS];
+	uint64_t num_above;
+	bool below_inclusive;   // some level below back-invalidates this one
+};
 
-///////////////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////
+// One cache of a level, with the name its stats are printed under
+struct Memsys_Cache {
+	Cache* c;
+	char* header;
+	Memsys_Level* level;
+	uint32_t core_id;       // of a private level's cache
+};
+
+// The levels an instruction fetch, or a load or store, walks before DRAM
+struct Memsys_Path {
+	Memsys_Level* level[HIER_MAX_LEVELS];
+	uint64_t num_levels;
+};
+
+struct Memsys {
+	Hier_Config* hier;
+	Memsys_Level level[HIER_MAX_LEVELS];
+	uint64_t num_levels;
+	Memsys_Path ipath;
+	Memsys_Path dpath;
+
+	// every cache, in the order memsys_print_stats() prints them
+	Memsys_Cache* caches;
+	uint64_t num_caches;    // also gives each cache its own random stream
 
-Memsys* memsys_new();
-void memsys_print_stats(Memsys* sys);
+	DRAM* dram;    // For Parts B,C,D,E
 
-uint64_t memsys_access(Memsys* sys, Addr addr, Access_Type type, uint32_t core_id);
-uint64_t memsys_access_modeA(Memsys* sys, Addr lineaddr, Access_Type type, uint32_t core_id);
-uint64_t memsys_access_modeBC(Memsys* sys, Addr lineaddr, Access_Type type, uint32_t core_id);
-uint64_t memsys_access_modeDE(Memsys* sys, Addr lineaddr, Access_Type type, uint32_t core_id);
+	// -tlb: an ITLB and a DTLB per core and a shared L2 TLB, each a Cache
+	// of page numbers. A miss in both walks the core's four-level page
+	// table, whose entries are loaded through the data caches. NULL
+	// without -tlb.
+	Cache** itlb;
+	Cache** dtlb;
+	Cache* l2tlb;
+
+	// stats, one entry per core
+	Memsys_Stats* core_stats;
+
+	// per core: instruction of the access in flight, trains the stride prefetchers
+	Addr* access_pc;
+
+	// per core: an exclusive level handed a dirty line up to the level filling it
+	bool* fill_dirty;
+
+	// per core: cycle the request being walked down the hierarchy reaches
+	// the current level, what its MSHRs are checked against
+	uint64_t* access_cycle;
+
+	// per core: page size of the access in flight, bounds the prefetches
+	uint64_t* access_page_size;
+
+	Sim_Config* cfg;        // configuration of the owning simulation
+	const uint64_t* clock;  // its cycle counter
+	Parsim* par;            // parallel engine, NULL when the cores run in one loop
+};
+
+
+
+///////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////
 
+Memsys* memsys_new(Sim_Config* cfg, const uint64_t* clock, Parsim* par);
+void memsys_free(Memsys* sys);
+void memsys_total_stats(Memsys* sys, Memsys_Stats* total);
+void memsys_print_stats(Memsys* sys, uint64_t cycles, FILE* out);
 
-// For parts B/C/D/E you must use this function to access L2 
-uint64_t memsys_L2_access(Memsys* sys, Addr lineaddr, bool is_writeback, uint32_t core_id);
-uint64_t memsys_L2_access_multicore(Memsys* sys, Addr lineaddr, bool is_writeback, uint32_t core_id);
+uint64_t memsys_access(Memsys* sys, Addr addr, Addr pc, Access_Type type, uint32_t core_id);
 
 // This function can convert VPN to PFN
 uint64_t memsys_convert_vpn_to_pfn(Memsys* sys, uint64_t vpn, uint32_t core_id);
@@ -0,0 +1,121 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mshr.h"
+
+extern void die_message(const char* msg);
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+Mshr* mshr_new(uint64_t num_entries){
+	if (num_entries == 0) {
+		die_message("A cache with MSHRs needs at least one");
+	}
+	Mshr* m = (Mshr*)calloc(1, sizeof(Mshr));
+	m->num_entries = num_entries;
+	m->lineaddr = (Addr*)calloc(num_entries, sizeof(Addr));
+	m->ready    = (uint64_t*)calloc(num_entries, sizeof(uint64_t));
+	return m;
+}
+
+// Free the MSHRs themselves (mshr_free() asks whether an entry is)
+void mshr_delete(Mshr* m){
+	free(m->lineaddr);
+	free(m->ready);
+	free(m);
+}
+
+////////////////////////////////////////////////////////////////////
+// A demand access at cycle to a line the cache holds: if its fill is
+// still in flight, merge into that miss. Returns the cycles left until
+// the fill completes, 0 if it is not in flight.
+////////////////////////////////////////////////////////////////////
+
+uint64_t mshr_merge(Mshr* m, Addr lineaddr, uint64_t cycle){
+	for (uint64_t i=0; i<m->num_entries; i++) {
+		if (m->lineaddr[i] == lineaddr && m->ready[i] > cycle) {
+			m->stat_merges++;
+			return m->ready[i] - cycle;
+		}
+	}
+	return 0;
+}
+
+// Is an entry free at cycle
+bool mshr_free(Mshr* m, uint64_t cycle){
+	for (uint64_t i=0; i<m->num_entries; i++) {
+		if (m->ready[i] <= cycle) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Cycles a miss at cycle has to wait for a free entry
+uint64_t mshr_stall(Mshr* m, uint64_t cycle){
+	uint64_t first_ready = UINT64_MAX;
+	for (uint64_t i=0; i<m->num_entries; i++) {
+		if (m->ready[i] <= cycle) {
+			return 0;
+		}
+		if (m->ready[i] < first_ready) {
+			first_ready = m->ready[i];
+		}
+	}
+	m->stat_full++;
+	m->stat_full_cycles += first_ready - cycle;
+	return first_ready - cycle;
+}
+
+////////////////////////////////////////////////////////////////////
+// Take a free entry at cycle (see mshr_stall()) for a fill that
+// completes at ready
+////////////////////////////////////////////////////////////////////
+
+void mshr_alloc(Mshr* m, Addr lineaddr, uint64_t cycle, uint64_t ready){
+	uint64_t busy = 1;
+	int64_t entry = -1;
+	for (uint64_t i=0; i<m->num_entries; i++) {
+		if (m->ready[i] > cycle) {
+			busy++;
+		}
+		else if (entry < 0) {
+			entry = i;
+		}
+	}
+	assert(entry >= 0);
+	m->lineaddr[entry] = lineaddr;
+	m->ready[entry] = ready;
+
+	m->stat_allocs++;
+	m->stat_busy_cycles += ready - cycle;
+	if (busy > m->stat_max_busy) {
+		m->stat_max_busy = busy;
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+// Occupancy is the average number of entries in flight over the run
+////////////////////////////////////////////////////////////////////
+
+void mshr_print_stats(Mshr* m, char* header, uint64_t cycles, FILE* out){
+	double merge_perc = 0, occupancy = 0;
+	if (m->stat_allocs + m->stat_merges) {
+		merge_perc = 100.0 * (double)m->stat_merges / (double)(m->stat_allocs + m->stat_merges);
+	}
+	if (cycles) {
+		occupancy = (double)m->stat_busy_cycles / (double)cycles;
+	}
+
+	fprintf(out, "\n%s_MSHR_ALLOCS     \t\t : %10llu", header, (unsigned long long)m->stat_allocs);
+	fprintf(out, "\n%s_MSHR_MERGES     \t\t : %10llu", header, (unsigned long long)m->stat_merges);
+	fprintf(out, "\n%s_MSHR_MERGE_PERC \t\t : %10.3f", header, merge_perc);
+	fprintf(out, "\n%s_MSHR_FULL       \t\t : %10llu", header, (unsigned long long)m->stat_full);
+	fprintf(out, "\n%s_MSHR_FULL_CYCLES\t\t : %10llu", header, (unsigned long long)m->stat_full_cycles);
+	fprintf(out, "\n%s_MSHR_PREFETCH_DROPS\t : %10llu", header, (unsigned long long)m->stat_prefetch_drops);
+	fprintf(out, "\n%s_MSHR_AVG_OCCUPANCY\t : %10.3f", header, occupancy);
+	fprintf(out, "\n%s_MSHR_MAX_OCCUPANCY\t : %10llu", header, (unsigned long long)m->stat_max_busy);
+	fprintf(out, "\n");
+}
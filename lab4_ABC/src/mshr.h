@@ -0,0 +1,52 @@
+#ifndef MSHR_H
+#define MSHR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "types.h"
+
+//////////////////////////////////////////////////////////////////
+// Miss status holding registers of one cache (the L1 dcache or the
+// L2). Caches install a missing line right away, so the MSHRs are what
+// remembers that its fill is still on the way: each entry holds the
+// line and the cycle its fill completes, and is free again from then.
+//
+// memsys takes an entry for every demand miss and prefetch fill of the
+// cache. A demand access to a line with an entry in flight merges into
+// that miss and waits only for the rest of its fill. A miss that finds
+// every entry busy stalls until the first one frees up; a prefetch is
+// dropped instead.
+//////////////////////////////////////////////////////////////////
+
+typedef struct Mshr Mshr;
+
+struct Mshr {
+	uint64_t  num_entries;
+	Addr*     lineaddr;
+	uint64_t* ready;             // cycle the entry's fill completes
+
+	// stats
+	uint64_t stat_allocs;        // misses (and prefetches) that took an entry
+	uint64_t stat_merges;        // accesses that merged into one in flight
+	uint64_t stat_full;          // misses that found every entry busy
+	uint64_t stat_full_cycles;   // ... and the cycles they stalled for one
+	uint64_t stat_prefetch_drops;// prefetches dropped for want of an entry
+	uint64_t stat_busy_cycles;   // cycles the entries were held, summed
+	uint64_t stat_max_busy;      // most entries in flight at once
+};
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+Mshr* mshr_new(uint64_t num_entries);
+void mshr_delete(Mshr* m);
+uint64_t mshr_merge(Mshr* m, Addr lineaddr, uint64_t cycle);
+bool mshr_free(Mshr* m, uint64_t cycle);
+uint64_t mshr_stall(Mshr* m, uint64_t cycle);
+void mshr_alloc(Mshr* m, Addr lineaddr, uint64_t cycle, uint64_t ready);
+void mshr_print_stats(Mshr* m, char* header, uint64_t cycles, FILE* out);
+
+//////////////////////////////////////////////////////////////////
+
+#endif // MSHR_H
@@ -0,0 +1,193 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sched.h>
+
+#include "parsim.h"
+#include "hostprof.h"
+#include "core.h"
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+Parsim* parsim_new(uint64_t num_cores, uint64_t quantum){
+	Parsim* par = new Parsim();
+	par->num_cores = num_cores;
+	par->quantum   = quantum;
+	par->shared_cycle = 0;
+
+	par->core = (Parsim_Core*)aligned_alloc(alignof(Parsim_Core), num_cores * sizeof(Parsim_Core));
+	for (uint64_t i=0; i<num_cores; i++) {
+		new (&par->core[i]) Parsim_Core();
+		par->core[i].cycle = 0;
+		par->core[i].safe.store(0);
+		par->core[i].quantum_cleared = 0;
+		par->core[i].stat_shared_waits  = 0;
+		par->core[i].stat_quantum_waits = 0;
+		par->core[i].stat_host_ns = 0;
+	}
+	return par;
+}
+
+// After parsim_finish()
+void parsim_free(Parsim* par){
+	for (uint64_t i=0; i<par->num_cores; i++) {
+		par->core[i].~Parsim_Core();
+	}
+	free(par->core);
+	delete par;
+}
+
+const uint64_t* parsim_core_clock(Parsim* par, uint64_t core_id){
+	return &par->core[core_id].cycle;
+}
+
+const uint64_t* parsim_shared_clock(Parsim* par){
+	return &par->shared_cycle;
+}
+
+static void parsim_wait(uint32_t* spins){
+	// spin briefly, then give the other cores the CPU
+	if (++(*spins) > 64) {
+		sched_yield();
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+// Called before every access of core_id to the shared levels
+////////////////////////////////////////////////////////////////////
+
+void parsim_shared_enter(Parsim* par, uint32_t core_id){
+	Parsim_Core* pc = &par->core[core_id];
+	uint64_t t = pc->cycle;
+
+	if (par->quantum) {
+		par->shared_lock.lock();
+		par->shared_cycle = t;
+		return;
+	}
+
+	// exact: wait for every access that comes before (t, core_id)
+	bool waited = false;
+	for (uint64_t j=0; j<par->num_cores; j++) {
+		if (j == core_id) {
+			continue;
+		}
+		uint32_t spins = 0;
+		while (true) {
+			uint64_t safe = par->core[j].safe.load(std::memory_order_acquire);
+			if (safe > t || (safe == t && j > core_id)) {
+				break;
+			}
+			waited = true;
+			parsim_wait(&spins);
+		}
+	}
+	if (waited) {
+		pc->stat_shared_waits++;
+	}
+	par->shared_cycle = t;
+}
+
+void parsim_shared_exit(Parsim* par, uint32_t core_id){
+	if (par->quantum) {
+		par->shared_lock.unlock();
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+// Bounded slack: do not start a new quantum until every core is in it
+////////////////////////////////////////////////////////////////////
+
+static void parsim_quantum_wait(Parsim* par, uint32_t core_id){
+	Parsim_Core* pc = &par->core[core_id];
+	uint64_t start = pc->cycle - pc->cycle % par->quantum;
+	if (start <= pc->quantum_cleared) {
+		return;
+	}
+
+	bool waited = false;
+	for (uint64_t j=0; j<par->num_cores; j++) {
+		uint32_t spins = 0;
+		while (j != core_id && par->core[j].safe.load(std::memory_order_acquire) < start) {
+			waited = true;
+			parsim_wait(&spins);
+		}
+	}
+	if (waited) {
+		pc->stat_quantum_waits++;
+	}
+	pc->quantum_cleared = start;
+}
+
+////////////////////////////////////////////////////////////////////
+// One thread per core. Cycles in which the core is snoozing are
+// no-ops, so the clock jumps straight to the next active cycle and
+// the other cores can run ahead that far.
+////////////////////////////////////////////////////////////////////
+
+static void parsim_core_thread(Parsim* par, Core* c){
+	Parsim_Core* pc = &par->core[c->core_id];
+	HOSTPROF_START(host_start);
+
+	while (!c->done) {
+		if (par->quantum) {
+			parsim_quantum_wait(par, c->core_id);
+		}
+
+		core_cycle(c);
+
+		pc->cycle++;
+		uint64_t next = core_next_active_cycle(c);
+		if (next > pc->cycle) {
+			pc->cycle = next;
+		}
+		pc->safe.store(c->done ? UINT64_MAX : pc->cycle, std::memory_order_release);
+	}
+	HOSTPROF_ADD(pc->stat_host_ns, host_start);
+}
+
+void parsim_start(Parsim* par, Core** core){
+	par->sim_core = core;
+	for (uint64_t i=0; i<par->num_cores; i++) {
+		par->core[i].safe.store(core[i]->done ? UINT64_MAX : par->core[i].cycle);
+	}
+	for (uint64_t i=0; i<par->num_cores; i++) {
+		par->core[i].thread = std::thread(parsim_core_thread, par, core[i]);
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+// Every core has finished all cycles before the returned one
+// (UINT64_MAX once all cores are done)
+////////////////////////////////////////////////////////////////////
+
+uint64_t parsim_progress(Parsim* par){
+	uint64_t progress = UINT64_MAX;
+	for (uint64_t i=0; i<par->num_cores; i++) {
+		uint64_t safe = par->core[i].safe.load(std::memory_order_acquire);
+		if (safe < progress) {
+			progress = safe;
+		}
+	}
+	return progress;
+}
+
+void parsim_finish(Parsim* par){
+	for (uint64_t i=0; i<par->num_cores; i++) {
+		par->core[i].thread.join();
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+void parsim_print_stats(Parsim* par, FILE* out){
+	fprintf(out, "\nPARSIM_QUANTUM      \t\t : %10llu", (unsigned long long)par->quantum);
+	for (uint64_t i=0; i<par->num_cores; i++) {
+		fprintf(out, "\nPARSIM_CORE_%llu_SHARED_WAITS\t : %10llu", (unsigned long long)i, (unsigned long long)par->core[i].stat_shared_waits);
+		fprintf(out, "\nPARSIM_CORE_%llu_QUANTUM_WAITS\t : %10llu", (unsigned long long)i, (unsigned long long)par->core[i].stat_quantum_waits);
+	}
+	fprintf(out, "\n");
+}
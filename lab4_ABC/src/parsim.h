@@ -0,0 +1,76 @@
+#ifndef PARSIM_H
+#define PARSIM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+#include "types.h"
+
+//////////////////////////////////////////////////////////////////
+// Parallel engine for modes D/E: every core, with its private caches,
+// runs on its own host thread with its own clock. Accesses to the shared
+// cache levels (the L2) and DRAM are bracketed by memsys_path_access()
+// with parsim_shared_enter()/parsim_shared_exit().
+//
+// quantum == 0 (exact lockstep): a core may touch the shared L2 at
+// cycle t only once every other core has either finished cycle t or is
+// at cycle t with a higher core id, i.e. in exactly the order the
+// single-threaded loop would use. Results are identical to a serial run.
+//
+// quantum > 0 (bounded slack): no core starts a quantum of that many
+// cycles before every core has reached it, and shared accesses are
+// applied in arrival order under a lock. Faster, but cores can see each
+// other's L2 traffic up to a quantum early or late, and results vary
+// from run to run.
+//////////////////////////////////////////////////////////////////
+
+typedef struct Parsim_Core Parsim_Core;
+typedef struct Parsim Parsim;
+typedef struct Core Core;
+
+struct alignas(64) Parsim_Core {
+	uint64_t cycle;                 // local clock, only written by the core's thread
+	std::atomic<uint64_t> safe;     // the core makes no shared access before this cycle
+	uint64_t quantum_cleared;       // start of the last quantum every core had reached
+
+	std::thread thread;
+
+	// stats
+	uint64_t stat_shared_waits;     // shared accesses that waited for another core
+	uint64_t stat_quantum_waits;    // quantum starts that waited for another core
+	uint64_t stat_host_ns;          // host time of the thread, HOST_PROFILE builds only
+};
+
+struct Parsim {
+	uint64_t num_cores;
+	uint64_t quantum;               // 0: exact lockstep
+	Parsim_Core* core;
+	Core** sim_core;
+
+	std::mutex shared_lock;         // bounded slack only
+	uint64_t shared_cycle;          // clock of the core being served by the L2
+};
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+Parsim* parsim_new(uint64_t num_cores, uint64_t quantum);
+void parsim_free(Parsim* par);
+const uint64_t* parsim_core_clock(Parsim* par, uint64_t core_id);
+const uint64_t* parsim_shared_clock(Parsim* par);
+
+void parsim_shared_enter(Parsim* par, uint32_t core_id);
+void parsim_shared_exit(Parsim* par, uint32_t core_id);
+
+void parsim_start(Parsim* par, Core** core);
+uint64_t parsim_progress(Parsim* par);
+void parsim_finish(Parsim* par);
+
+void parsim_print_stats(Parsim* par, FILE* out);
+
+//////////////////////////////////////////////////////////////////
+
+#endif // PARSIM_H
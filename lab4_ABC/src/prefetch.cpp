@@ -0,0 +1,200 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+#include "prefetch.h"
+
+extern void die_message(const char* msg);
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+Prefetcher* prefetch_new(uint64_t type, uint64_t degree, uint64_t distance){
+	if (type == PREFETCH_NONE || type >= NUM_PREFETCH_TYPES) {
+		die_message("Unknown prefetcher");
+	}
+	if (degree == 0 || distance == 0) {
+		die_message("Prefetch degree and distance must be at least 1");
+	}
+
+	Prefetcher* pf = (Prefetcher*)calloc(1, sizeof(Prefetcher));
+	pf->type     = (Prefetch_Type)type;
+	pf->degree   = degree;
+	pf->distance = distance;
+	pf->candidates = (Addr*)calloc(degree, sizeof(Addr));
+
+	if (type == PREFETCH_STRIDE) {
+		pf->stride_table = (Prefetch_Stride_Entry*)calloc(PREFETCH_STRIDE_ENTRIES, sizeof(Prefetch_Stride_Entry));
+	}
+	if (type == PREFETCH_STREAM) {
+		pf->streams = (Prefetch_Stream*)calloc(PREFETCH_STREAMS, sizeof(Prefetch_Stream));
+	}
+	return pf;
+}
+
+void prefetch_free(Prefetcher* pf){
+	free(pf->candidates);
+	free(pf->stride_table);
+	free(pf->streams);
+	free(pf);
+}
+
+////////////////////////////////////////////////////////////////////
+// A prefetcher by number or by name, e.g. "3" or "stream"
+////////////////////////////////////////////////////////////////////
+
+static const char* prefetch_names[NUM_PREFETCH_TYPES] = {
+	"none", "next", "stride", "stream",
+};
+
+uint64_t prefetch_parse(const char* s){
+	if (s[0] >= '0' && s[0] <= '9') {
+		uint64_t type = strtoull(s, NULL, 10);
+		if (type < NUM_PREFETCH_TYPES) {
+			return type;
+		}
+	}
+	for (uint64_t i=0; i<NUM_PREFETCH_TYPES; i++) {
+		if (!strcasecmp(s, prefetch_names[i])) {
+			return i;
+		}
+	}
+	printf("Prefetcher is %s\n", s);
+	die_message("Unknown prefetcher");
+	return PREFETCH_NONE;
+}
+
+////////////////////////////////////////////////////////////////////
+// Candidates base + step*(distance+i) for i < degree; lines that would
+// fall below address 0 are left out
+////////////////////////////////////////////////////////////////////
+
+static uint64_t prefetch_fill(Prefetcher* pf, Addr base, int64_t step){
+	uint64_t n = 0;
+	for (uint64_t i=0; i<pf->degree; i++) {
+		int64_t offset = step * (int64_t)(pf->distance + i);
+		if (offset < 0 && (Addr)(-offset) > base) {
+			break;
+		}
+		pf->candidates[n++] = base + offset;
+	}
+	if (n) {
+		pf->stat_triggers++;
+	}
+	return n;
+}
+
+static uint64_t prefetch_train_stride(Prefetcher* pf, Addr lineaddr, Addr pc){
+	Prefetch_Stride_Entry* e = &pf->stride_table[(pc ^ (pc >> 8)) % PREFETCH_STRIDE_ENTRIES];
+
+	if (e->pc != pc) {
+		e->pc = pc;
+		e->last_lineaddr = lineaddr;
+		e->stride = 0;
+		e->confidence = 0;
+		return 0;
+	}
+
+	int64_t stride = (int64_t)(lineaddr - e->last_lineaddr);
+	if (stride == 0) {
+		// another access to the same line tells us nothing
+		return 0;
+	}
+	e->last_lineaddr = lineaddr;
+
+	if (stride == e->stride) {
+		if (e->confidence < 3) {
+			e->confidence++;
+		}
+	} else if (e->confidence > 0) {
+		e->confidence--;
+	} else {
+		e->stride = stride;
+	}
+
+	return (e->confidence >= 2) ? prefetch_fill(pf, lineaddr, e->stride) : 0;
+}
+
+static uint64_t prefetch_train_stream(Prefetcher* pf, Addr lineaddr){
+	Prefetch_Stream* victim = &pf->streams[0];
+	pf->stream_clock++;
+
+	for (uint64_t i=0; i<PREFETCH_STREAMS; i++) {
+		Prefetch_Stream* s = &pf->streams[i];
+		if (!s->valid) {
+			if (victim->valid) {
+				victim = s;
+			}
+			continue;
+		}
+		if (victim->valid && s->last_use < victim->last_use) {
+			victim = s;
+		}
+
+		int64_t delta = (int64_t)(lineaddr - s->head);
+		int64_t ahead = (s->dir == 0) ? (delta < 0 ? -delta : delta) : delta * s->dir;
+		if (ahead < 1 || ahead > PREFETCH_STREAM_WINDOW) {
+			continue;
+		}
+
+		if (s->dir == 0) {
+			s->dir = (delta > 0) ? 1 : -1;
+		}
+		s->head = lineaddr;
+		s->last_use = pf->stream_clock;
+		return prefetch_fill(pf, lineaddr, s->dir);
+	}
+
+	// a new stream, direction still unknown
+	victim->valid = true;
+	victim->head = lineaddr;
+	victim->dir = 0;
+	victim->last_use = pf->stream_clock;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////
+// Train with one demand access. trigger: the access missed, or was the
+// first use of a prefetched line. Returns the number of candidates in
+// pf->candidates.
+////////////////////////////////////////////////////////////////////
+
+uint64_t prefetch_train(Prefetcher* pf, Addr lineaddr, Addr pc, bool trigger){
+	switch (pf->type) {
+		case PREFETCH_NEXT_LINE:
+			return trigger ? prefetch_fill(pf, lineaddr, 1) : 0;
+		case PREFETCH_STRIDE:
+			return prefetch_train_stride(pf, lineaddr, pc);
+		case PREFETCH_STREAM:
+			return trigger ? prefetch_train_stream(pf, lineaddr) : 0;
+		default:
+			return 0;
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+// Accuracy: used / issued. Coverage: the share of the misses the cache
+// would have had without prefetching that the prefetches removed.
+////////////////////////////////////////////////////////////////////
+
+void prefetch_print_stats(Prefetcher* pf, char* header, uint64_t demand_misses, FILE* out){
+	double accuracy = 0, coverage = 0;
+	if (pf->stat_issued) {
+		accuracy = (double)pf->stat_useful / (double)pf->stat_issued;
+	}
+	if (pf->stat_useful + demand_misses) {
+		coverage = (double)pf->stat_useful / (double)(pf->stat_useful + demand_misses);
+	}
+
+	fprintf(out, "\n%s_PREFETCH_ISSUED \t\t : %10llu", header, (unsigned long long)pf->stat_issued);
+	fprintf(out, "\n%s_PREFETCH_USEFUL \t\t : %10llu", header, (unsigned long long)pf->stat_useful);
+	fprintf(out, "\n%s_PREFETCH_LATE   \t\t : %10llu", header, (unsigned long long)pf->stat_late);
+	fprintf(out, "\n%s_PREFETCH_USELESS\t\t : %10llu", header, (unsigned long long)pf->stat_useless);
+	fprintf(out, "\n%s_PREFETCH_ACCURACY_PERC\t : %10.3f", header, 100*accuracy);
+	fprintf(out, "\n%s_PREFETCH_COVERAGE_PERC\t : %10.3f", header, 100*coverage);
+	fprintf(out, "\n%s_PREFETCH_DRAM_READS\t\t : %10llu", header, (unsigned long long)pf->stat_dram_reads);
+	fprintf(out, "\n%s_PREFETCH_DRAM_WRITES\t : %10llu", header, (unsigned long long)pf->stat_dram_writes);
+	fprintf(out, "\n");
+}
@@ -0,0 +1,88 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "types.h"
+
+//////////////////////////////////////////////////////////////////
+// Hardware prefetcher of one cache (the L1 dcache or the L2).
+// memsys trains it with every demand access to its cache, gets back
+// up to degree candidate line addresses, and fills the ones the cache
+// does not hold yet from the next level. Prefetched lines carry a
+// prefetch bit (CACHE_META_PREFETCH) and the cycle their fill
+// completes, so the cache can tell useful, late and useless ones.
+//
+// NEXT_LINE: on a miss (or the first hit on a prefetched line), the
+//   lines distance .. distance+degree-1 ahead
+// STRIDE: a reference prediction table indexed by the instruction
+//   address; once an instruction has repeated its line stride, the
+//   lines distance .. distance+degree-1 strides ahead
+// STREAM: stream detection over misses; a miss just past the head of
+//   a tracked stream confirms its direction and runs the stream ahead
+//////////////////////////////////////////////////////////////////
+
+#define PREFETCH_STRIDE_ENTRIES  256
+#define PREFETCH_STREAMS         16
+#define PREFETCH_STREAM_WINDOW   16     // lines past a stream's head that still continue it
+
+typedef struct Prefetch_Stride_Entry Prefetch_Stride_Entry;
+typedef struct Prefetch_Stream Prefetch_Stream;
+typedef struct Prefetcher Prefetcher;
+
+typedef enum Prefetch_Type_Enum {
+	PREFETCH_NONE=0,
+	PREFETCH_NEXT_LINE=1,
+	PREFETCH_STRIDE=2,
+	PREFETCH_STREAM=3,
+	NUM_PREFETCH_TYPES
+} Prefetch_Type;
+
+struct Prefetch_Stride_Entry {
+	Addr     pc;
+	Addr     last_lineaddr;
+	int64_t  stride;
+	uint32_t confidence;   // 0..3, prefetches from 2
+};
+
+struct Prefetch_Stream {
+	bool     valid;
+	Addr     head;         // last line that continued the stream
+	int64_t  dir;          // +1/-1, 0 until a second miss sets it
+	uint64_t last_use;
+};
+
+struct Prefetcher {
+	Prefetch_Type type;
+	uint64_t degree;       // candidates per trigger
+	uint64_t distance;     // lines (or strides) ahead of the trigger
+
+	Prefetch_Stride_Entry* stride_table;
+	Prefetch_Stream* streams;
+	uint64_t stream_clock;
+
+	Addr* candidates;      // degree entries, filled by prefetch_train()
+
+	// stats
+	uint64_t stat_triggers;     // trainings that produced candidates
+	uint64_t stat_issued;       // fills of lines the cache did not hold
+	uint64_t stat_useful;       // prefetched lines a demand access used
+	uint64_t stat_late;         // ... before their fill had completed
+	uint64_t stat_useless;      // prefetched lines evicted unused
+	uint64_t stat_dram_reads;   // DRAM reads of the fills
+	uint64_t stat_dram_writes;  // DRAM writebacks of the lines they evicted
+};
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+Prefetcher* prefetch_new(uint64_t type, uint64_t degree, uint64_t distance);
+void prefetch_free(Prefetcher* pf);
+uint64_t prefetch_parse(const char* s);
+uint64_t prefetch_train(Prefetcher* pf, Addr lineaddr, Addr pc, bool trigger);
+void prefetch_print_stats(Prefetcher* pf, char* header, uint64_t demand_misses, FILE* out);
+
+//////////////////////////////////////////////////////////////////
+
+#endif // PREFETCH_H
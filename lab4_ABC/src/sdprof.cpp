@@ -0,0 +1,131 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "sdprof.h"
+
+////////////////////////////////////////////////////////////////////
+// One set count per power-of-two size in [min_size, max_size]. The
+// stacks are calloc()ed, so only the sets the trace touches take memory.
+////////////////////////////////////////////////////////////////////
+
+Sdprof* sdprof_new(uint64_t min_size, uint64_t max_size, uint64_t linesize, uint64_t assoc, uint64_t depth){
+	Sdprof* p = (Sdprof*)calloc(1, sizeof(Sdprof));
+	p->linesize = linesize;
+	p->assoc    = assoc;
+	p->depth    = (depth > assoc) ? depth : assoc;
+
+	uint64_t max_sets = 0;
+	for (uint64_t size = min_size; size && size <= max_size; size *= 2) {
+		max_sets++;
+	}
+	p->sets = (Sdprof_Sets*)calloc(max_sets ? max_sets : 1, sizeof(Sdprof_Sets));
+
+	for (uint64_t size = min_size; size && size <= max_size; size *= 2) {
+		uint64_t num_sets = size / (linesize * assoc);
+		if (num_sets == 0 || (p->num_sets && p->sets[p->num_sets-1].num_sets == num_sets)) {
+			continue;
+		}
+		Sdprof_Sets* s = &p->sets[p->num_sets++];
+		s->num_sets = num_sets;
+		s->stack = (Addr*)calloc(num_sets * p->depth, sizeof(Addr));
+		s->fill  = (uint32_t*)calloc(num_sets, sizeof(uint32_t));
+		s->hist  = (uint64_t*)calloc(p->depth + 1, sizeof(uint64_t));
+	}
+
+	return p;
+}
+
+void sdprof_free(Sdprof* p){
+	for (uint64_t i=0; i<p->num_sets; i++) {
+		free(p->sets[i].stack);
+		free(p->sets[i].fill);
+		free(p->sets[i].hist);
+	}
+	free(p->sets);
+	free(p);
+}
+
+////////////////////////////////////////////////////////////////////
+// Record the stack distance of lineaddr for every set count and move
+// it to the top of its stacks
+////////////////////////////////////////////////////////////////////
+
+void sdprof_access(Sdprof* p, Addr lineaddr){
+	p->stat_accesses++;
+
+	for (uint64_t g=0; g<p->num_sets; g++) {
+		Sdprof_Sets* s = &p->sets[g];
+		uint64_t set = lineaddr % s->num_sets;
+		Addr* stack = &s->stack[set * p->depth];
+		uint32_t fill = s->fill[set];
+
+		uint32_t pos = 0;
+		while (pos < fill && stack[pos] != lineaddr) {
+			pos++;
+		}
+
+		if (pos < fill) {
+			s->hist[pos]++;
+		}
+		else {
+			s->hist[p->depth]++;
+			if (fill < p->depth) {
+				s->fill[set]++;
+			}
+			else {
+				pos = p->depth - 1;   // the LRU entry falls off
+			}
+		}
+
+		memmove(stack + 1, stack, pos * sizeof(Addr));
+		stack[0] = lineaddr;
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+// Miss ratio of an LRU cache with s->num_sets sets and assoc ways
+////////////////////////////////////////////////////////////////////
+
+double sdprof_miss_ratio(Sdprof* p, Sdprof_Sets* s, uint64_t assoc){
+	assert(assoc >= 1 && assoc <= p->depth);
+	if (p->stat_accesses == 0) {
+		return 0;
+	}
+
+	uint64_t misses = 0;
+	for (uint64_t d=assoc; d<=p->depth; d++) {
+		misses += s->hist[d];
+	}
+	return (double)misses / (double)(p->stat_accesses);
+}
+
+////////////////////////////////////////////////////////////////////
+// Miss ratio curve at the profiled cache's associativity
+////////////////////////////////////////////////////////////////////
+
+void sdprof_print_stats(Sdprof* p, char* header, FILE* out){
+	for (uint64_t g=0; g<p->num_sets; g++) {
+		Sdprof_Sets* s = &p->sets[g];
+		unsigned long long size_kb = s->num_sets * p->assoc * p->linesize / 1024;
+		fprintf(out, "\n%s_MRC_%lluKB   \t\t : %10.3f", header, size_kb, 100*sdprof_miss_ratio(p, s, p->assoc));
+	}
+	fprintf(out, "\n");
+}
+
+////////////////////////////////////////////////////////////////////
+// Every (sets, assoc) point: cache,sets,assoc,size_bytes,accesses,miss_perc
+////////////////////////////////////////////////////////////////////
+
+void sdprof_write_csv(Sdprof* p, char* header, FILE* csv){
+	for (uint64_t g=0; g<p->num_sets; g++) {
+		Sdprof_Sets* s = &p->sets[g];
+		for (uint64_t a=1; a<=p->depth; a++) {
+			fprintf(csv, "%s,%llu,%llu,%llu,%llu,%.3f\n", header,
+			        (unsigned long long)s->num_sets, (unsigned long long)a,
+			        (unsigned long long)(s->num_sets * a * p->linesize),
+			        (unsigned long long)p->stat_accesses, 100*sdprof_miss_ratio(p, s, a));
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef SDPROF_H
+#define SDPROF_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "types.h"
+
+//////////////////////////////////////////////////////////////////
+// Stack-distance (Mattson) profiling of one cache's access stream.
+// For every set count of interest we keep a per-set LRU stack of line
+// addresses, depth entries deep, and a histogram of the stack position
+// each access hits at. An LRU cache with that many sets and a ways
+// misses on exactly the accesses at position >= a, so one pass gives
+// the miss ratio of every associativity up to depth, and the list of
+// set counts covers sizes min_size..max_size at the cache's own
+// associativity.
+//////////////////////////////////////////////////////////////////
+
+typedef struct Sdprof_Sets Sdprof_Sets;
+typedef struct Sdprof Sdprof;
+
+struct Sdprof_Sets {
+	uint64_t num_sets;
+	Addr*     stack;     // num_sets * depth line addresses, MRU first
+	uint32_t* fill;      // valid entries per set
+	uint64_t* hist;      // depth+1 buckets, hist[depth]: cold or deeper
+};
+
+struct Sdprof {
+	uint64_t linesize;
+	uint64_t assoc;      // associativity of the profiled cache
+	uint64_t depth;
+
+	Sdprof_Sets* sets;
+	uint64_t num_sets;
+
+	uint64_t stat_accesses;
+};
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+Sdprof* sdprof_new(uint64_t min_size, uint64_t max_size, uint64_t linesize, uint64_t assoc, uint64_t depth);
+void sdprof_free(Sdprof* p);
+void sdprof_access(Sdprof* p, Addr lineaddr);
+double sdprof_miss_ratio(Sdprof* p, Sdprof_Sets* s, uint64_t assoc);
+void sdprof_print_stats(Sdprof* p, char* header, FILE* out);
+void sdprof_write_csv(Sdprof* p, char* header, FILE* csv);
+
+//////////////////////////////////////////////////////////////////
+
+#endif // SDPROF_H
@@ -17,56 +17,36 @@
 #include <string.h>
 #include <inttypes.h>
 #include <assert.h>
+#include <thread>
+#include <chrono>
 
 #include "types.h"
 #include "memsys.h"
+#include "hier.h"
 #include "core.h"
+#include "sim.h"
+#include "sweep.h"
+#include "jobs.h"
+#include "hostprof.h"
 
-#define PRINT_DOTS   1
-#define DOT_INTERVAL 100000
+#define PRINT_PROGRESS    1
+#define PROGRESS_INTERVAL 5000000  // cycles between progress lines
 
 /***************************************************************************
  * Globals
  **************************************************************************/
 
-MODE        SIM_MODE        = SIM_MODE_A;
-uint64_t       CACHE_LINESIZE  = 64;
-uint64_t       REPL_POLICY     = 0; // 0:FIFO 1:SWP (Part E)  2:NEW (Part F)
-
-uint64_t       DCACHE_SIZE     = 32*1024;
-uint64_t       DCACHE_ASSOC    = 8;
-
-uint64_t       ICACHE_SIZE     = 32*1024;
-uint64_t       ICACHE_ASSOC    = 8;
-
-uint64_t       L2CACHE_SIZE    = 1024*1024;
-uint64_t       L2CACHE_ASSOC   = 16;
-uint64_t       L2CACHE_REPL    = 0;
-
-uint64_t       SWP_CORE0_WAYS  = 0;
-
-uint64_t       NUM_CORES       = 1;
-
-bool 	    DRAM_PAGE_POLICY = 0;
+char*       SWEEP_FILE      = NULL; // run every configuration listed in this file
+uint64_t       SWEEP_THREADS   = 0;    // 0: one worker per hardware thread
+char*       JOBS_FILE       = NULL; // run every simulation listed in this file
+uint64_t       JOBS_THREADS    = 0;    // 0: one worker per hardware thread
 
 /***************************************************************************************
  * Functions
  ***************************************************************************************/
-void print_dots(void);
-void die_usage();
-void die_message(const char* msg);
-void get_params(int argc, char** argv);
-void print_stats();
-
-/***************************************************************************************
- * Globals
- ***************************************************************************************/
-
-Memsys* memsys;
-Core* core[MAX_CORES];
-char trace_filename[MAX_CORES][1024];
-uint64_t last_printdot_cycle;
-uint64_t cycle;
+void print_progress(Sim* sim, bool done);
+void skip_idle_cycles(Sim* sim);
+static bool sim_run_parallel(Sim* sim);
 
 /***************************************************************************************
  * Main
@@ -75,83 +55,415 @@ int main(int argc, char** argv)
 {
     srand(42);
 
-    get_params(argc, argv);
+    Sim_Config cfg;
+    sim_config_init(&cfg);
+    sim_config_parse(&cfg, argc, argv, SIM_CONFIG_COMMAND_LINE);
 
-    assert(NUM_CORES<=MAX_CORES);
+    if (cfg.parallel && cfg.sim_mode != SIM_MODE_D && cfg.sim_mode != SIM_MODE_E) {
+		die_message("-parallel needs a multicore mode (-mode 4 or 5)");
+    }
 
-    //---- Initialize the system
-    memsys = memsys_new();
+    if (cfg.parallel && cfg.interval_out) {
+		die_message("-interval_out cannot be combined with -parallel");
+    }
+
+    if (JOBS_FILE) {
+		if (SWEEP_FILE || cfg.parallel) {
+			die_message("-jobs cannot be combined with -sweep or -parallel");
+		}
+		jobs_run(&cfg, JOBS_FILE, JOBS_THREADS);
+		return 0;
+    }
 
-    for (int i=0; i<NUM_CORES; i++) {
-		core[i] = core_new(memsys,trace_filename[i],i);
+    if (SWEEP_FILE) {
+		if (cfg.parallel) {
+			die_message("-parallel cannot be combined with -sweep");
+		}
+		sweep_run(&cfg, SWEEP_FILE, SWEEP_THREADS);
+		return 0;
     }
 
-    print_dots();
+    //---- Initialize the system
+    Sim* sim = sim_new(&cfg, NULL);
+    sim->show_progress = PRINT_PROGRESS;
 
     //--------------------------------------------------------------------
     // -- Iterate until all cores are done
     //--------------------------------------------------------------------
-    bool all_cores_done = 0;
+    sim_run(sim, UINT64_MAX);
+    print_progress(sim, true);
 
-    while(!all_cores_done) {
-    	all_cores_done=1;
-    	for(int i=0; i<NUM_CORES; i++){
-			core_cycle(core[i]);
-			all_cores_done &= core[i]->done;
-      	}
+    sim_print_stats(sim, stdout);
+    return 0;
+}
 
-      	if (cycle - last_printdot_cycle >= DOT_INTERVAL) {
-			print_dots();
-      	}
+//--------------------------------------------------------------------
+// -- Defaults for every option
+//--------------------------------------------------------------------
 
-      	cycle++;
-    }
+void sim_config_init(Sim_Config* cfg){
+	memset(cfg, 0, sizeof(Sim_Config));
 
-    print_stats();
-    return 0;
+	cfg->sim_mode       = SIM_MODE_A;
+	cfg->cache_linesize = 64;
+	cfg->repl_policy    = 0;
+	cfg->repl_seed      = 1;
+	cfg->ucp_epoch_cycles = 5000000;
+
+	cfg->dcache_size    = 32*1024;
+	cfg->dcache_assoc   = 8;
+
+	cfg->icache_size    = 32*1024;
+	cfg->icache_assoc   = 8;
+
+	cfg->l2cache_size   = 1024*1024;
+	cfg->l2cache_assoc  = 16;
+	cfg->l2cache_repl   = UINT64_MAX;
+
+	cfg->dcache_prefetch_degree    = 2;
+	cfg->dcache_prefetch_distance  = 1;
+	cfg->dcache_victim_latency     = 1;
+	cfg->l2cache_prefetch_degree   = 2;
+	cfg->l2cache_prefetch_distance = 1;
+
+	cfg->itlb_entries   = 64;
+	cfg->itlb_assoc     = 4;
+	cfg->dtlb_entries   = 64;
+	cfg->dtlb_assoc     = 4;
+	cfg->l2tlb_entries  = 1536;
+	cfg->l2tlb_assoc    = 12;
+	cfg->l2tlb_latency  = 7;
+
+	cfg->page_size      = 4096;
+
+	cfg->rob_size       = 128;
+	cfg->issue_width    = 4;
+	cfg->retire_width   = 4;
+
+	cfg->num_cores      = 1;
+
+	cfg->event_skip     = 1;
+	cfg->cache_specialize = 1;
+
+	cfg->sdprof_min_size = 64*1024;
+	cfg->sdprof_max_size = 64*1024*1024;
+}
+
+//--------------------------------------------------------------------
+// -- Build one simulation. With trace_share, core i reads the shared
+// -- decode of trace i instead of opening trace_filename[i] itself.
+//--------------------------------------------------------------------
+
+Trace* sim_open_trace(Sim_Config* cfg, const char* fname){
+	Trace* t = trace_open(fname);
+
+	// sampled / chunked runs: simulate [trace_skip_inst, trace_skip_inst+trace_max_inst)
+	if (cfg->trace_skip_inst) {
+		trace_seek(t, cfg->trace_skip_inst);
+	}
+	if (cfg->trace_max_inst) {
+		trace_set_limit(t, cfg->trace_max_inst);
+	}
+
+	if (cfg->trace_prefetch_entries) {
+		trace_start_prefetch(t, cfg->trace_prefetch_entries);
+	}
+	return t;
+}
+
+Sim* sim_new(Sim_Config* cfg, Trace_Share** trace_share){
+	Sim* sim = (Sim*)calloc(1, sizeof(Sim));
+	sim->cfg = *cfg;
+	sim->trace_share = trace_share;
+	sim->start_ns = hostprof_now();
+
+	if (sim->cfg.parallel) {
+		sim->par = parsim_new(sim->cfg.num_cores, sim->cfg.quantum);
+	}
+
+	sim->memsys = memsys_new(&sim->cfg, &sim->cycle, sim->par);
+
+	sim->core = (Core**)calloc(sim->cfg.num_cores, sizeof(Core*));
+	for (uint64_t i=0; i<sim->cfg.num_cores; i++) {
+		Trace* t;
+		if (trace_share) {
+			t = trace_open_shared(trace_share[i]);
+		}
+		else {
+			t = sim_open_trace(&sim->cfg, sim->cfg.trace_filename[i]);
+		}
+		const uint64_t* clock = sim->par ? parsim_core_clock(sim->par, i) : &sim->cycle;
+		sim->core[i] = core_new(sim->memsys, t, i, clock);
+	}
+
+	// a sweep or jobs file may set the period on the command line and the file per line
+	if ((sim->cfg.interval_cycles || sim->cfg.interval_inst) != (sim->cfg.interval_out != NULL)) {
+		die_message("-interval_out and one of -interval_cycles/-interval_inst go together");
+	}
+	if (sim->cfg.interval_out) {
+		sim->interval = interval_new(&sim->cfg, sim->memsys, sim->core);
+	}
+
+	return sim;
+}
+
+//--------------------------------------------------------------------
+// -- Run until all cores are done or the clock reaches max_cycles.
+// -- Returns true once all cores are done.
+//--------------------------------------------------------------------
+
+bool sim_run(Sim* sim, uint64_t max_cycles){
+	HOSTPROF_START(host_start);
+
+	if (sim->par) {
+		sim_run_parallel(sim);
+		HOSTPROF_ADD(sim->stat_host_ns, host_start);
+		return true;
+	}
+
+	while (!sim->all_cores_done && sim->cycle < max_cycles) {
+		sim->all_cores_done = 1;
+		for (uint64_t i=0; i<sim->cfg.num_cores; i++) {
+			core_cycle(sim->core[i]);
+			sim->all_cores_done &= sim->core[i]->done;
+		}
+
+		if (sim->interval) {
+			HOSTPROF_START(stats_start);
+			interval_cycle(sim->interval, sim->cycle+1);
+			HOSTPROF_ADD(sim->stat_stats_ns, stats_start);
+		}
+
+		if (sim->cycle - sim->last_progress_cycle >= PROGRESS_INTERVAL) {
+			print_progress(sim, false);
+		}
+
+		if (sim->cfg.event_skip && !sim->all_cores_done) {
+			skip_idle_cycles(sim);
+		}
+
+		sim->cycle++;
+	}
+
+	if (sim->all_cores_done && sim->interval && sim->interval->out) {
+		interval_finish(sim->interval, sim->cycle);
+	}
+
+	HOSTPROF_ADD(sim->stat_host_ns, host_start);
+	return sim->all_cores_done;
+}
+
+//--------------------------------------------------------------------
+// -- Parallel engine: the cores run on their own threads, and this
+// -- thread only prints the progress lines the serial loop would print.
+// -- The run ends one cycle after the last core finishes, as above.
+//--------------------------------------------------------------------
+
+static bool sim_run_parallel(Sim* sim){
+	parsim_start(sim->par, sim->core);
+
+	uint64_t progress;
+	while ((progress = parsim_progress(sim->par)) != UINT64_MAX) {
+		while (sim->last_progress_cycle + PROGRESS_INTERVAL < progress) {
+			sim->cycle = sim->last_progress_cycle + PROGRESS_INTERVAL;
+			print_progress(sim, false);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	parsim_finish(sim->par);
+
+	uint64_t last_cycle = 0;
+	for (uint64_t i=0; i<sim->cfg.num_cores; i++) {
+		if (sim->core[i]->done_cycle_count > last_cycle) {
+			last_cycle = sim->core[i]->done_cycle_count;
+		}
+	}
+	while (sim->last_progress_cycle + PROGRESS_INTERVAL <= last_cycle) {
+		sim->cycle = sim->last_progress_cycle + PROGRESS_INTERVAL;
+		print_progress(sim, false);
+	}
+
+	sim->cycle = last_cycle + 1;
+	sim->all_cores_done = true;
+	return true;
+}
+
+//--------------------------------------------------------------------
+// -- Where the host time of sim_run() went. Cache is memsys_access()
+// -- without the DRAM model; core is everything not measured. With
+// -- -parallel the components are timed on every core's thread, so
+// -- the shares are of the thread time summed over the threads.
+//--------------------------------------------------------------------
+
+#if HOST_PROFILE
+static void sim_print_host_profile(Sim* sim, FILE* out){
+	Memsys_Stats total;
+	memsys_total_stats(sim->memsys, &total);
+
+	uint64_t trace_ns = 0;
+	for (uint64_t i=0; i<sim->cfg.num_cores; i++) {
+		trace_ns += sim->core[i]->stat_trace_ns;
+	}
+	uint64_t dram_ns  = sim->memsys->dram ? sim->memsys->dram->stat_host_ns : 0;
+	uint64_t cache_ns = total.stat_host_ns - dram_ns;
+	uint64_t host_ns  = sim->stat_host_ns;
+	uint64_t thread_ns = host_ns;
+	if (sim->par) {
+		// the progress lines are this thread's only work
+		thread_ns = sim->stat_stats_ns;
+		for (uint64_t i=0; i<sim->cfg.num_cores; i++) {
+			thread_ns += sim->par->core[i].stat_host_ns;
+		}
+	}
+	uint64_t known_ns = trace_ns + total.stat_host_ns + sim->stat_stats_ns;
+	uint64_t core_ns  = (thread_ns > known_ns) ? thread_ns - known_ns : 0;
+
+	double scale = thread_ns ? 100.0 / thread_ns : 0;
+
+	fprintf(out, "\n");
+	fprintf(out, "\nHOSTPROF_SECONDS     \t\t : %10.3f", host_ns / 1e9);
+	if (sim->par) {
+		fprintf(out, "\nHOSTPROF_THREAD_SECONDS\t : %10.3f", thread_ns / 1e9);
+	}
+	fprintf(out, "\nHOSTPROF_TRACE_PERC  \t\t : %10.3f", trace_ns * scale);
+	fprintf(out, "\nHOSTPROF_CACHE_PERC  \t\t : %10.3f", cache_ns * scale);
+	fprintf(out, "\nHOSTPROF_DRAM_PERC   \t\t : %10.3f", dram_ns * scale);
+	fprintf(out, "\nHOSTPROF_STATS_PERC  \t\t : %10.3f", sim->stat_stats_ns * scale);
+	fprintf(out, "\nHOSTPROF_CORE_PERC   \t\t : %10.3f", core_ns * scale);
 }
+#endif
 
 //--------------------------------------------------------------------
 // -- Print statistics
 //--------------------------------------------------------------------
 
-void print_stats(){
+void sim_print_stats(Sim* sim, FILE* out){
 
-  printf("\n");
-  printf("\nCYCLES      \t\t\t : %10llu", cycle);
+  fprintf(out, "\n");
+  fprintf(out, "\nCYCLES      \t\t\t : %10llu", (unsigned long long)sim->cycle);
 
-  for(int i=0; i<NUM_CORES; i++) {
-    core_print_stats(core[i]);
+  for(uint64_t i=0; i<sim->cfg.num_cores; i++) {
+    core_print_stats(sim->core[i], out);
   }
 
-  memsys_print_stats(memsys);
+  memsys_print_stats(sim->memsys, sim->cycle, out);
+
+  if (sim->par) {
+    parsim_print_stats(sim->par, out);
+  }
 
-  printf("\n\n");
+#if HOST_PROFILE
+  sim_print_host_profile(sim, out);
+#endif
+
+  fprintf(out, "\n\n");
 }
 
 //--------------------------------------------------------------------
-// -- Print Hearbeats
+// -- Free a finished simulation once its stats are printed (which
+// -- closes the traces), so a -jobs batch holds only the running ones
 //--------------------------------------------------------------------
 
+void sim_free(Sim* sim){
+	if (sim->interval) {
+		interval_free(sim->interval);
+	}
+	for (uint64_t i=0; i<sim->cfg.num_cores; i++) {
+		core_free(sim->core[i]);
+	}
+	free(sim->core);
+	memsys_free(sim->memsys);
+	if (sim->par) {
+		parsim_free(sim->par);
+	}
+	free(sim);
+}
 
-void print_dots(){
-	uint32_t LINE_INTERVAL = 50 *  DOT_INTERVAL;
+//--------------------------------------------------------------------
+// -- Event-driven mode: if no core can make progress before cycle N,
+// -- move straight to N-1 (the loop increments to N). Progress lines that
+// -- fall in the skipped range are still printed at their own cycle.
+//--------------------------------------------------------------------
 
-	last_printdot_cycle = cycle;
+void skip_idle_cycles(Sim* sim){
+	uint64_t next_cycle = UINT64_MAX;
+	for (uint64_t i=0; i<sim->cfg.num_cores; i++) {
+		uint64_t core_next = core_next_active_cycle(sim->core[i]);
+		if (core_next < next_cycle) {
+			next_cycle = core_next;
+		}
+	}
 
-	if (!PRINT_DOTS) {
+	if (next_cycle <= sim->cycle+1) {
 		return;
 	}
 
- 	if (cycle % LINE_INTERVAL == 0) {
-		printf("\n%4llu M\t", cycle/1000000);
-		fflush(stdout);
+	while (sim->last_progress_cycle + PROGRESS_INTERVAL < next_cycle) {
+		sim->cycle = sim->last_progress_cycle + PROGRESS_INTERVAL;
+		print_progress(sim, false);
 	}
-    else{
-		printf(".");
-		fflush(stdout);
-    }
 
+	if (sim->interval) {
+		HOSTPROF_START(stats_start);
+		interval_skip(sim->interval, next_cycle);
+		HOSTPROF_ADD(sim->stat_stats_ns, stats_start);
+	}
+
+	sim->cycle = next_cycle - 1;
+}
+
+//--------------------------------------------------------------------
+// -- Print Progress: simulated instructions and cycles per host
+// -- second, and an ETA from how far the slowest core is through its
+// -- trace. With done, the totals of the whole run instead.
+//--------------------------------------------------------------------
+
+void print_progress(Sim* sim, bool done){
+	sim->last_progress_cycle = sim->cycle;
+
+	if (!sim->show_progress) {
+		return;
+	}
+	HOSTPROF_START(stats_start);
+
+	// with -parallel the cores are still running on their own threads
+	uint64_t inst = 0;
+	double fraction = 1;
+	for (uint64_t i=0; i<sim->cfg.num_cores; i++) {
+		Core* c = sim->core[i];
+		uint64_t core_inst = __atomic_load_n(&c->inst_count, __ATOMIC_RELAXED);
+		inst += core_inst;
+		if (!__atomic_load_n(&c->done, __ATOMIC_RELAXED)) {
+			double f = trace_fraction_done(c->trace, core_inst);
+			if (f < fraction) {
+				fraction = f;
+			}
+		}
+	}
+
+	double secs = (hostprof_now() - sim->start_ns) / 1e9;
+	if (secs <= 0) {
+		secs = 1e-9;
+	}
+
+	printf("\n%7.1f M cycles %9.3f M inst | %8.3f MIPS %8.3f M cycles/s | ",
+	       sim->cycle / 1e6, inst / 1e6, inst / secs / 1e6, sim->cycle / secs / 1e6);
+
+	uint64_t eta = 0;
+	if (done) {
+		eta = secs;
+		printf("done in %" PRIu64 ":%02" PRIu64, eta / 60, eta % 60);
+	}
+	else if (fraction > 0) {
+		eta = secs * (1 - fraction) / fraction;
+		printf("%5.1f%% ETA %" PRIu64 ":%02" PRIu64, 100 * fraction, eta / 60, eta % 60);
+	}
+	else {
+		printf("  ---  ETA  ---");
+	}
+	fflush(stdout);
+
+	HOSTPROF_ADD(sim->stat_stats_ns, stats_start);
 }
 
 
@@ -160,17 +472,82 @@ void print_dots(){
 //--------------------------------------------------------------------
 
 void die_usage(){
-    printf("Usage : sim [-option <value>] trace_0 <trace_1> \n");
+    printf("Usage : sim [-option <value>] trace_0 <trace_1> ... <trace_N-1>  (one core per trace)\n");
     printf("   Options\n");
     printf("      -mode            <num>    Set mode of the simulator[1:PartA, 2:PartB, 3:PartC 4:PartD]  (Default: 1)\n");
     printf("      -linesize        <num>    Set cache linesize for all caches (Default:64)\n");
-    printf("      -repl            <num>    Set replacement policy for L1 cache [0:FIFO,1:RND] (Default:0)\n");
+    printf("      -repl            <num>    Set replacement policy for the L1 caches, by number or name (Default:0)\n");
+    printf("                                [0:FIFO, 6:LRU, 7:PLRU, 8:RND, 9:SRRIP, 10:BRRIP, 11:DRRIP]\n");
+    printf("      -repl_seed       <num>    Seed the random choices of RND, BRRIP and DRRIP (Default:1)\n");
     printf("      -DsizeKB         <num>    Set capacity in KB of the the Level 1 DCACHE (Default:32 KB)\n");
     printf("      -Dassoc          <num>    Set associativity of the the Level 1 DCACHE (Default:8)\n");
     printf("      -L2sizeKB        <num>    Set capacity in KB of the unified Level 2 cache (Default: 512 KB)\n");
-    printf("      -L2repl          <num>    Set replacement policy for L2 cache [0:FIFO,1:RND,2:SWP, 3:NEW] (Default:0)\n");
-    printf("      -SWP_core0ways   <num>    Set static quota for core_0 for SWP (Default:1)\n");
+    printf("      -L2assoc         <num>    Set associativity of the unified Level 2 cache (Default:16)\n");
+    printf("      -L2repl          <num>    Set replacement policy for L2 cache: the -repl policies, or [1:SWP, 2:NEW, 4:UCP]\n");
+    printf("                                (Default: -repl in modes A-C, FIFO in modes D-F)\n");
+    printf("      -L2inclusion     <num>    Set inclusion of the L2 towards the L1s by number or name\n");
+    printf("                                [0:Noninclusive, 1:Inclusive, 2:Exclusive] (Default:0)\n");
+    printf("      -SWP_core0ways   <num>    Set static quota for core_0 for SWP; other cores split the rest (Default:0)\n");
+    printf("      -SWP_quotas      <list>   Set static SWP quota for every core, e.g. 4,4,4,4 (Overrides -SWP_core0ways)\n");
+    printf("      -Dprefetch       <num>    Set prefetcher of the L1 DCACHE by number or name [0:None, 1:Next, 2:Stride, 3:Stream] (Default:0)\n");
+    printf("      -Dprefetch_degree <num>   Lines the L1 DCACHE prefetcher fetches per trigger (Default:2)\n");
+    printf("      -Dprefetch_distance <num> Lines (or strides) ahead of the trigger it starts (Default:1)\n");
+    printf("      -Dvictim         <num>    Entries of a fully-associative victim cache behind each L1 DCACHE [0:None] (Default:0)\n");
+    printf("      -Dvictim_latency <num>    Extra cycles of a victim cache hit (Default:1)\n");
+    printf("      -Dmshr           <num>    MSHRs of each L1 DCACHE: misses to a line in flight merge, and a miss stalls\n");
+    printf("                                while all are busy [0:Not modeled] (Default:0)\n");
+    printf("      -L2mshr          <num>    MSHRs of the L2 cache, as -Dmshr (Default:0)\n");
+    printf("      -Dwrite_allocate <num>    A store miss in the L1 DCACHE reads the line in, else passes the write on [0:Off, 1:On] (Default:1)\n");
+    printf("      -Dwrite_through  <num>    The L1 DCACHE passes every write on to the L2 [0:Write-back, 1:Write-through] (Default:0)\n");
+    printf("      -L2write_allocate <num>   As -Dwrite_allocate, for the L2 cache (Default:1)\n");
+    printf("      -L2write_through <num>    As -Dwrite_through, for the L2 cache (Default:0)\n");
+    printf("      -L2prefetch      <num>    Set prefetcher of the L2 cache, as -Dprefetch (Default:0)\n");
+    printf("      -L2prefetch_degree <num>  Lines the L2 prefetcher fetches per trigger (Default:2)\n");
+    printf("      -L2prefetch_distance <num> Lines (or strides) ahead of the trigger it starts (Default:1)\n");
+    printf("      -hier            <file>   Build the cache hierarchy from <file>, one level per line (see hier.h);\n");
+    printf("                                the cache size, assoc, L2repl and prefetch options are then ignored\n");
+    printf("      -UCP_epoch       <num>    Repartition the UCP ways every <num> cycles [0:Keep the even split] (Default:5000000)\n");
+    printf("      -tlb             <num>    Model per-core ITLBs and DTLBs, a shared L2 TLB and page walks through the\n");
+    printf("                                data caches [0:Off, 1:On] (Default:0)\n");
+    printf("      -ITLBentries     <num>    Entries of each ITLB (Default:64)\n");
+    printf("      -ITLBassoc       <num>    Associativity of each ITLB (Default:4)\n");
+    printf("      -DTLBentries     <num>    Entries of each DTLB (Default:64)\n");
+    printf("      -DTLBassoc       <num>    Associativity of each DTLB (Default:4)\n");
+    printf("      -L2TLBentries    <num>    Entries of the shared L2 TLB (Default:1536)\n");
+    printf("      -L2TLBassoc      <num>    Associativity of the L2 TLB (Default:12)\n");
+    printf("      -L2TLB_latency   <num>    Extra cycles of an L1 TLB miss that hits in the L2 TLB (Default:7)\n");
+    printf("      -page_sizeKB     <num>    Page size of the translation, the page walks and the prefetchers' page\n");
+    printf("                                boundaries [4, 2048] (Default:4)\n");
+    printf("      -huge_pages      <list>   Map these virtual address ranges with 2MB pages, e.g. 0x400000-0x800000,...\n");
+    printf("                                Either option also reports DRAM row locality and cache set conflicts\n");
     printf("      -dram_policy     <num>    Set DRAM page policy [0:Open Page Policy, 1: Close Page Policy](Default:0)\n");
+    printf("      -ooo             <num>    Out-of-order core: loads issue under outstanding misses [0:Off, 1:On] (Default:0)\n");
+    printf("      -rob             <num>    Instruction window (ROB) entries of the out-of-order core (Default:128)\n");
+    printf("      -issue_width     <num>    Instructions the out-of-order core dispatches per cycle (Default:4)\n");
+    printf("      -retire_width    <num>    Instructions it retires in order per cycle (Default:4)\n");
+    printf("      -store_buffer    <num>    Store buffer entries; stores drain to the L1 DCACHE in order and the core\n");
+    printf("                                stalls while it is full [0:Stores cost nothing] (Default:0)\n");
+    printf("      -event_skip      <num>    Skip cycles where every core is waiting on memory [0:Off, 1:On] (Default:1)\n");
+    printf("      -cache_spec      <num>    Use cache code specialized for common assoc/sets/policy [0:Off, 1:On] (Default:1)\n");
+    printf("      -trace_prefetch  <num>    Decode traces on a producer thread into a ring of <num> records [0:Off] (Default:0)\n");
+    printf("      -trace_skip      <num>    Start each core at instruction <num> of its trace (Default:0)\n");
+    printf("      -trace_max       <num>    Stop each core after <num> instructions [0:Whole trace] (Default:0)\n");
+    printf("      -sdprof          <num>    Profile stack distances of every cache; miss-ratio curves for assoc 1..<num> [0:Off] (Default:0)\n");
+    printf("      -sdprof_minKB    <num>    Smallest cache size of the miss-ratio curves (Default:64 KB)\n");
+    printf("      -sdprof_maxKB    <num>    Largest cache size of the miss-ratio curves (Default:65536 KB)\n");
+    printf("      -sdprof_csv      <file>   Write every (sets, assoc) point of the curves to <file>\n");
+    printf("      -interval_cycles <num>    Sample interval stats (IPC, miss rates, delays, DRAM row hits) every <num> cycles\n");
+    printf("      -interval_inst   <num>    Sample interval stats every <num> instructions over all cores instead\n");
+    printf("      -interval_out    <file>   Write the interval samples to <file>, as JSON if it ends in .json, else CSV\n");
+    printf("      -parallel        <num>    Run each core on its own host thread, modes 4/5 only [0:Off, 1:On] (Default:0)\n");
+    printf("      -quantum         <num>    With -parallel: cores may drift <num> cycles apart [0:Exact lockstep] (Default:0)\n");
+    printf("      -sweep           <file>   Run every configuration in <file> in one pass over the traces. Each line is\n");
+    printf("                                \"<output file> [-option <value>] ...\", applied on top of the command line\n");
+    printf("      -sweep_threads   <num>    Worker threads for -sweep [0:One per hardware thread] (Default:0)\n");
+    printf("      -jobs            <file>   Run every simulation in <file> on a pool of worker threads. Each line is\n");
+    printf("                                \"<output file> [-option <value>] ... [trace_0 ...]\", applied on top of the\n");
+    printf("                                command line; lines without traces use the command-line traces\n");
+    printf("      -jobs_threads    <num>    Worker threads for -jobs [0:One per hardware thread] (Default:0)\n");
     exit(0);
 }
 
@@ -185,75 +562,434 @@ void die_message(const char * msg){
 }
 
 //--------------------------------------------------------------------
-// -- Read Parameters from Command Line
+// -- Read Parameters from the command line, or from one line of a
+// -- sweep or jobs file. A sweep shares its traces and the options that
+// -- set up the trace front end across all its configurations, so they
+// -- are only accepted on the command line. A job runs on its own and
+// -- may name its own traces, but not start another sweep, batch or
+// -- parallel run.
 //--------------------------------------------------------------------
 
-void get_params(int argc, char** argv){
+static const char* FRONT_END_OPTIONS[] = {
+	"-trace_prefetch", "-trace_skip", "-trace_max", NULL
+};
+
+static const char* PROCESS_OPTIONS[] = {
+	"-sweep", "-sweep_threads", "-jobs", "-jobs_threads", "-parallel", "-quantum", NULL
+};
+
+static void check_option_source(const char* opt, Sim_Config_Source source){
+	bool allowed = true;
+	for (int f = 0; PROCESS_OPTIONS[f]; f++) {
+		if (!strcmp(opt, PROCESS_OPTIONS[f])) {
+			allowed = (source == SIM_CONFIG_COMMAND_LINE);
+		}
+	}
+	for (int f = 0; FRONT_END_OPTIONS[f]; f++) {
+		if (!strcmp(opt, FRONT_END_OPTIONS[f])) {
+			allowed = (source != SIM_CONFIG_SWEEP);
+		}
+	}
+	if (!allowed) {
+		char msg[256];
+		snprintf(msg, sizeof(msg), "%s is not allowed in a %s file", opt,
+		         (source == SIM_CONFIG_SWEEP) ? "sweep" : "jobs");
+		die_message(msg);
+	}
+}
+
+void sim_config_parse(Sim_Config* cfg, int argc, char** argv, Sim_Config_Source source){
 	int num_trace_filename = 0;
+	char** trace_filename = (char**)calloc(argc+1, sizeof(char*));
+	char* swp_quotas = NULL;
+	char* huge_pages = NULL;
+	char* inherited_interval_out = cfg->interval_out;
 
-	if (argc < 2) {
-	die_usage();
+	if (source == SIM_CONFIG_COMMAND_LINE && argc < 2) {
+		die_usage();
 	}
 
     //--------------------------------------------------------------------
     // -- Get command line options
     //--------------------------------------------------------------------
-    for (int i = 1; i < argc; i++) {
+    for (int i = (source == SIM_CONFIG_COMMAND_LINE) ? 1 : 0; i < argc; i++) {
 		if (argv[i][0] == '-') {
+			check_option_source(argv[i], source);
+
 			if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "-help")) {
 				die_usage();
 			}
 			else if (!strcmp(argv[i], "-mode")) {
 				if (i < argc - 1) {
-					SIM_MODE = (MODE)atoi(argv[i+1]);
+					cfg->sim_mode = (MODE)atoi(argv[i+1]);
 					i++;
 				}
 			}
 			else if (!strcmp(argv[i], "-linesize")) {
 				if (i < argc - 1) {
-					CACHE_LINESIZE = atoi(argv[i+1]);
+					cfg->cache_linesize = atoi(argv[i+1]);
 					i++;
 				}
 			}
 			else if (!strcmp(argv[i], "-repl")) {
 				if (i < argc - 1) {
-					REPL_POLICY = atoi(argv[i+1]);
+					cfg->repl_policy = cache_repl_parse(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-repl_seed")) {
+				if (i < argc - 1) {
+					cfg->repl_seed = strtoull(argv[i+1], NULL, 10);
 					i++;
 				}
 			}
 			else if (!strcmp(argv[i], "-DsizeKB")) {
 				if (i < argc - 1) {
-					DCACHE_SIZE = atoi(argv[i+1])*1024;
+					cfg->dcache_size = atoi(argv[i+1])*1024;
 					i++;
 				}
 			}
 			else if (!strcmp(argv[i], "-Dassoc")) {
 				if (i < argc - 1) {
-					DCACHE_ASSOC = atoi(argv[i+1]);
+					cfg->dcache_assoc = atoi(argv[i+1]);
 					i++;
 				}
 			}
 			else if (!strcmp(argv[i], "-L2sizeKB")) {
 				if (i < argc - 1) {
-					L2CACHE_SIZE = atoi(argv[i+1])*1024;
+					cfg->l2cache_size = atoi(argv[i+1])*1024;
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-L2assoc")) {
+				if (i < argc - 1) {
+					cfg->l2cache_assoc = atoi(argv[i+1]);
 					i++;
 				}
 			}
 			else if (!strcmp(argv[i], "-L2repl")) {
 				if (i < argc - 1) {
-					L2CACHE_REPL = atoi(argv[i+1]);
+					cfg->l2cache_repl = cache_repl_parse(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-L2inclusion")) {
+				if (i < argc - 1) {
+					cfg->l2cache_inclusion = hier_inclusion_parse(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-Dprefetch")) {
+				if (i < argc - 1) {
+					cfg->dcache_prefetch = prefetch_parse(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-Dprefetch_degree")) {
+				if (i < argc - 1) {
+					cfg->dcache_prefetch_degree = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-Dprefetch_distance")) {
+				if (i < argc - 1) {
+					cfg->dcache_prefetch_distance = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-Dvictim")) {
+				if (i < argc - 1) {
+					cfg->dcache_victim_entries = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-Dvictim_latency")) {
+				if (i < argc - 1) {
+					cfg->dcache_victim_latency = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-Dmshr")) {
+				if (i < argc - 1) {
+					cfg->dcache_mshrs = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-L2mshr")) {
+				if (i < argc - 1) {
+					cfg->l2cache_mshrs = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-Dwrite_allocate")) {
+				if (i < argc - 1) {
+					cfg->dcache_no_write_allocate = !atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-Dwrite_through")) {
+				if (i < argc - 1) {
+					cfg->dcache_write_through = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-L2write_allocate")) {
+				if (i < argc - 1) {
+					cfg->l2cache_no_write_allocate = !atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-L2write_through")) {
+				if (i < argc - 1) {
+					cfg->l2cache_write_through = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-L2prefetch")) {
+				if (i < argc - 1) {
+					cfg->l2cache_prefetch = prefetch_parse(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-L2prefetch_degree")) {
+				if (i < argc - 1) {
+					cfg->l2cache_prefetch_degree = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-L2prefetch_distance")) {
+				if (i < argc - 1) {
+					cfg->l2cache_prefetch_distance = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-hier")) {
+				if (i < argc - 1) {
+					cfg->hier = hier_read(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-UCP_epoch")) {
+				if (i < argc - 1) {
+					cfg->ucp_epoch_cycles = strtoull(argv[i+1], NULL, 10);
 					i++;
 				}
 			}
 			else if (!strcmp(argv[i], "-SWP_core0ways")) {
 				if (i < argc - 1) {
-					SWP_CORE0_WAYS = atoi(argv[i+1]);
+					cfg->swp_core0_ways = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-SWP_quotas")) {
+				if (i < argc - 1) {
+					swp_quotas = argv[i+1];
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-tlb")) {
+				if (i < argc - 1) {
+					cfg->tlb = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-ITLBentries")) {
+				if (i < argc - 1) {
+					cfg->itlb_entries = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-ITLBassoc")) {
+				if (i < argc - 1) {
+					cfg->itlb_assoc = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-DTLBentries")) {
+				if (i < argc - 1) {
+					cfg->dtlb_entries = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-DTLBassoc")) {
+				if (i < argc - 1) {
+					cfg->dtlb_assoc = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-L2TLBentries")) {
+				if (i < argc - 1) {
+					cfg->l2tlb_entries = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-L2TLBassoc")) {
+				if (i < argc - 1) {
+					cfg->l2tlb_assoc = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-L2TLB_latency")) {
+				if (i < argc - 1) {
+					cfg->l2tlb_latency = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-page_sizeKB")) {
+				if (i < argc - 1) {
+					cfg->page_size = strtoull(argv[i+1], NULL, 10) * 1024;
+					cfg->layout_stats = true;
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-huge_pages")) {
+				if (i < argc - 1) {
+					huge_pages = argv[i+1];
+					cfg->layout_stats = true;
 					i++;
 				}
 			}
 			else if (!strcmp(argv[i], "-dram_policy")) {
 				if (i < argc - 1) {
-					DRAM_PAGE_POLICY = atoi(argv[i+1]);
+					cfg->dram_page_policy = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-ooo")) {
+				if (i < argc - 1) {
+					cfg->core_ooo = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-rob")) {
+				if (i < argc - 1) {
+					cfg->rob_size = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-issue_width")) {
+				if (i < argc - 1) {
+					cfg->issue_width = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-retire_width")) {
+				if (i < argc - 1) {
+					cfg->retire_width = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-store_buffer")) {
+				if (i < argc - 1) {
+					cfg->store_buffer_entries = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-event_skip")) {
+				if (i < argc - 1) {
+					cfg->event_skip = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-cache_spec")) {
+				if (i < argc - 1) {
+					cfg->cache_specialize = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-trace_prefetch")) {
+				if (i < argc - 1) {
+					cfg->trace_prefetch_entries = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-trace_skip")) {
+				if (i < argc - 1) {
+					cfg->trace_skip_inst = strtoull(argv[i+1], NULL, 10);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-trace_max")) {
+				if (i < argc - 1) {
+					cfg->trace_max_inst = strtoull(argv[i+1], NULL, 10);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-sdprof")) {
+				if (i < argc - 1) {
+					cfg->sdprof_depth = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-sdprof_minKB")) {
+				if (i < argc - 1) {
+					cfg->sdprof_min_size = strtoull(argv[i+1], NULL, 10)*1024;
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-sdprof_maxKB")) {
+				if (i < argc - 1) {
+					cfg->sdprof_max_size = strtoull(argv[i+1], NULL, 10)*1024;
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-sdprof_csv")) {
+				if (i < argc - 1) {
+					cfg->sdprof_csv = argv[i+1];
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-interval_cycles")) {
+				if (i < argc - 1) {
+					cfg->interval_cycles = strtoull(argv[i+1], NULL, 10);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-interval_inst")) {
+				if (i < argc - 1) {
+					cfg->interval_inst = strtoull(argv[i+1], NULL, 10);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-interval_out")) {
+				if (i < argc - 1) {
+					cfg->interval_out = argv[i+1];
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-parallel")) {
+				if (i < argc - 1) {
+					cfg->parallel = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-quantum")) {
+				if (i < argc - 1) {
+					cfg->quantum = strtoull(argv[i+1], NULL, 10);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-sweep")) {
+				if (i < argc - 1) {
+					SWEEP_FILE = argv[i+1];
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-sweep_threads")) {
+				if (i < argc - 1) {
+					SWEEP_THREADS = atoi(argv[i+1]);
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-jobs")) {
+				if (i < argc - 1) {
+					JOBS_FILE = argv[i+1];
+					i++;
+				}
+			}
+			else if (!strcmp(argv[i], "-jobs_threads")) {
+				if (i < argc - 1) {
+					JOBS_THREADS = atoi(argv[i+1]);
 					i++;
 				}
 			}
@@ -263,23 +999,114 @@ void get_params(int argc, char** argv){
 				die_message(msg);
 			}
 		}
-		else if (num_trace_filename < MAX_CORES) {
-			strcpy(trace_filename[num_trace_filename], argv[i]);
-			num_trace_filename++;
-			NUM_CORES = num_trace_filename;
-		}
 		else {
-			char msg[256];
-			sprintf(msg, "Invalid option %s, got filename %s", argv[i], trace_filename[NUM_CORES]);
-			die_message(msg);
+			if (source == SIM_CONFIG_SWEEP) {
+				die_message("Trace files are not allowed in a sweep file");
+			}
+			// one core per trace file
+			trace_filename[num_trace_filename] = argv[i];
+			num_trace_filename++;
 		}
     }
 
     //--------------------------------------------------------------------
     // Error checking
     //--------------------------------------------------------------------
-    if (num_trace_filename == 0) {
+    if (num_trace_filename) {
+		// a job with its own traces does not inherit per-core quotas
+		if (cfg->swp_quotas && (uint64_t)num_trace_filename != cfg->num_cores) {
+			cfg->swp_quotas = NULL;
+		}
+		cfg->trace_filename = trace_filename;
+		cfg->num_cores = num_trace_filename;
+    }
+    else {
+		free(trace_filename);
+    }
+
+    if (source == SIM_CONFIG_COMMAND_LINE && num_trace_filename == 0 && !JOBS_FILE) {
 		die_message("Must provide at least one trace file");
     }
+    if (source == SIM_CONFIG_JOB && cfg->trace_filename == NULL) {
+		die_message("Job has no trace files, and none were given on the command line");
+    }
 
+    if (cfg->interval_cycles && cfg->interval_inst) {
+		die_message("Use only one of -interval_cycles and -interval_inst");
+    }
+    if (source != SIM_CONFIG_COMMAND_LINE && cfg->interval_out && cfg->interval_out == inherited_interval_out) {
+		die_message("Every sweep or jobs line needs its own -interval_out");
+    }
+
+    if (swp_quotas) {
+		cfg->swp_quotas = (uint64_t*)calloc(cfg->num_cores, sizeof(uint64_t));
+		uint64_t num_quotas = 0;
+		for (char* tok = strtok(swp_quotas, ","); tok; tok = strtok(NULL, ",")) {
+			if (num_quotas == cfg->num_cores) {
+				die_message("-SWP_quotas has more entries than there are cores");
+			}
+			cfg->swp_quotas[num_quotas++] = atoi(tok);
+		}
+		if (num_quotas != cfg->num_cores) {
+			die_message("-SWP_quotas needs one entry per core");
+		}
+    }
+
+    if (cfg->page_size != 4096 && cfg->page_size != 2048*1024) {
+		die_message("-page_sizeKB must be 4 or 2048");
+    }
+
+    // start-end pairs of virtual addresses, on 2MB boundaries
+    if (huge_pages) {
+		uint64_t max_regions = 1;
+		for (char* s = huge_pages; *s; s++) {
+			max_regions += (*s == ',');
+		}
+		cfg->huge_page_start = (Addr*)calloc(max_regions, sizeof(Addr));
+		cfg->huge_page_end   = (Addr*)calloc(max_regions, sizeof(Addr));
+		cfg->num_huge_regions = 0;
+		for (char* tok = strtok(huge_pages, ","); tok; tok = strtok(NULL, ",")) {
+			char* end;
+			Addr start = strtoull(tok, &end, 0);
+			if (*end != '-') {
+				die_message("-huge_pages needs start-end address ranges");
+			}
+			Addr stop = strtoull(end+1, NULL, 0);
+			if (start % (2048*1024) || stop % (2048*1024) || stop <= start) {
+				die_message("-huge_pages ranges must start and end on 2MB boundaries");
+			}
+			cfg->huge_page_start[cfg->num_huge_regions] = start;
+			cfg->huge_page_end[cfg->num_huge_regions] = stop;
+			cfg->num_huge_regions++;
+		}
+    }
+
+}
+
+//--------------------------------------------------------------------
+// -- Split one line of a sweep or jobs file into options. Blank lines
+// -- and everything after a '#' are ignored. The options keep pointing
+// -- into a private copy of the line, so it is never freed. Returns
+// -- the number of options, or -1 if there are more than max_args.
+//--------------------------------------------------------------------
+
+int sim_config_split(const char* line, char** args, int max_args){
+	char* copy = strdup(line);
+	char* comment = strchr(copy, '#');
+	if (comment) {
+		*comment = '\0';
+	}
+
+	// tokenize first: the option parser uses strtok() itself
+	int num_args = 0;
+	for (char* tok = strtok(copy, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+		if (num_args == max_args) {
+			return -1;
+		}
+		args[num_args++] = tok;
+	}
+	if (num_args == 0) {
+		free(copy);
+	}
+	return num_args;
 }
@@ -0,0 +1,68 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "memsys.h"
+#include "core.h"
+#include "trace.h"
+#include "interval.h"
+
+//////////////////////////////////////////////////////////////////
+// One simulation: its configuration, clock, memory system and cores.
+// Nothing here is global, so several simulations can share a process.
+//////////////////////////////////////////////////////////////////
+
+typedef struct Sim Sim;
+
+struct Sim {
+	Sim_Config cfg;
+
+	uint64_t cycle;
+	uint64_t last_progress_cycle;
+	bool     show_progress;   // progress lines on stdout (single-simulation runs)
+	uint64_t start_ns;        // host time at sim_new()
+
+	Memsys*  memsys;
+	Core**   core;
+	Parsim*  par;             // -parallel, else NULL
+	Interval* interval;       // -interval_out, else NULL
+
+	// sweep mode: per-core shared decoded trace, NULL to open trace_filename
+	Trace_Share** trace_share;
+
+	bool     all_cores_done;
+
+	// host time, HOST_PROFILE builds only (see hostprof.h)
+	uint64_t stat_host_ns;    // in sim_run()
+	uint64_t stat_stats_ns;   // sampling interval stats and printing progress
+};
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+// where a set of options comes from; see sim_config_parse()
+typedef enum Sim_Config_Source_Enum {
+	SIM_CONFIG_COMMAND_LINE=0,
+	SIM_CONFIG_SWEEP=1,      // one line of a -sweep file
+	SIM_CONFIG_JOB=2,        // one line of a -jobs file
+} Sim_Config_Source;
+
+void sim_config_init(Sim_Config* cfg);
+void sim_config_parse(Sim_Config* cfg, int argc, char** argv, Sim_Config_Source source);
+int  sim_config_split(const char* line, char** args, int max_args);
+
+Trace* sim_open_trace(Sim_Config* cfg, const char* fname);
+Sim* sim_new(Sim_Config* cfg, Trace_Share** trace_share);
+bool sim_run(Sim* sim, uint64_t max_cycles);
+void sim_print_stats(Sim* sim, FILE* out);
+void sim_free(Sim* sim);
+
+void die_usage();
+void die_message(const char* msg);
+
+//////////////////////////////////////////////////////////////////
+
+#endif // SIM_H
@@ -0,0 +1,236 @@
+ /*************************************************************************
+ * File         : sweep.cpp
+ * Description  : Single-pass multi-configuration sweeps over shared traces
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <vector>
+
+#include "sim.h"
+#include "sweep.h"
+
+#define SWEEP_MAX_ARGS        256
+#define SWEEP_SLICE_CYCLES    100000 // cycles a configuration runs before its worker picks again
+#define SWEEP_MAX_LAG_CHUNKS  8      // decoded chunks a configuration's cores may each run ahead of the slowest reader
+
+typedef struct Sweep_Job Sweep_Job;
+typedef struct Sweep Sweep;
+
+struct Sweep_Job {
+	Sim_Config cfg;
+	char out_fname[1024];
+	Sim* sim;
+	bool done;
+};
+
+struct Sweep {
+	Sweep_Job* jobs;
+	uint64_t num_jobs;
+	uint64_t num_threads;
+
+	Trace_Share** trace_share;   // one per core/trace
+
+	std::mutex print_lock;
+	uint64_t jobs_done;
+};
+
+////////////////////////////////////////////////////////////////////
+// One configuration per line: "<output file> [-option <value>] ...".
+// Blank lines and everything after a '#' are ignored.
+////////////////////////////////////////////////////////////////////
+
+static void sweep_read_file(Sweep* sw, Sim_Config* base, const char* sweep_fname){
+	FILE* f = fopen(sweep_fname, "r");
+	if (f == NULL) {
+		printf("Sweep file is %s\n", sweep_fname);
+		die_message("Unable to open the sweep file");
+	}
+
+	uint64_t max_jobs = 64;
+	sw->jobs = (Sweep_Job*)calloc(max_jobs, sizeof(Sweep_Job));
+
+	char line[4096];
+	uint64_t line_num = 0;
+	while (fgets(line, sizeof(line), f)) {
+		line_num++;
+		char* args[SWEEP_MAX_ARGS];
+		int num_args = sim_config_split(line, args, SWEEP_MAX_ARGS);
+		if (num_args < 0) {
+			printf("Sweep file is %s, line %" PRIu64 "\n", sweep_fname, line_num);
+			die_message("Too many options on one sweep line");
+		}
+		if (num_args == 0) {
+			continue;
+		}
+
+		if (sw->num_jobs == max_jobs) {
+			max_jobs *= 2;
+			sw->jobs = (Sweep_Job*)realloc(sw->jobs, max_jobs * sizeof(Sweep_Job));
+		}
+		Sweep_Job* job = &sw->jobs[sw->num_jobs++];
+		memset(job, 0, sizeof(Sweep_Job));
+		strncpy(job->out_fname, args[0], sizeof(job->out_fname)-1);
+		job->cfg = *base;
+		sim_config_parse(&job->cfg, num_args-1, args+1, SIM_CONFIG_SWEEP);
+	}
+	fclose(f);
+
+	if (sw->num_jobs == 0) {
+		die_message("No configurations in the sweep file");
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+// How far the job's most advanced core is ahead of the slowest reader
+// of its trace, in decoded chunks. oldest: one of its cores is the
+// slowest reader of its trace, so the chunks it holds wait on this job.
+////////////////////////////////////////////////////////////////////
+
+static uint64_t sweep_job_lag(Sweep_Job* job, bool* oldest){
+	uint64_t lag = 0;
+	*oldest = false;
+	for (uint64_t i=0; i<job->cfg.num_cores; i++) {
+		Core* c = job->sim->core[i];
+		if (c->done) {
+			continue;
+		}
+		uint64_t core_lag = trace_share_lag(c->trace);
+		if (core_lag == 0) {
+			*oldest = true;
+		}
+		if (core_lag > lag) {
+			lag = core_lag;
+		}
+	}
+	return lag;
+}
+
+static void sweep_job_finish(Sweep* sw, Sweep_Job* job){
+	FILE* out = fopen(job->out_fname, "w");
+	if (out == NULL) {
+		printf("Output file is %s\n", job->out_fname);
+		die_message("Unable to create the sweep output file");
+	}
+	sim_print_stats(job->sim, out);
+	fclose(out);
+	job->done = true;
+
+	std::lock_guard<std::mutex> guard(sw->print_lock);
+	sw->jobs_done++;
+	printf("SWEEP %4" PRIu64 "/%-4" PRIu64 " %-40s CYCLES %12" PRIu64 "\n",
+	       sw->jobs_done, sw->num_jobs, job->out_fname, job->sim->cycle);
+	fflush(stdout);
+}
+
+////////////////////////////////////////////////////////////////////
+// Worker w owns jobs w, w+num_threads, ... It advances, of its jobs
+// that may run, the one furthest behind, and waits while none may. A
+// job may run while none of its cores is more than
+// SWEEP_MAX_LAG_CHUNKS ahead of the slowest reader of its trace, or
+// while one of them is that slowest reader: every trace's oldest chunk
+// can always be released, so the sweep cannot deadlock.
+////////////////////////////////////////////////////////////////////
+
+static void sweep_worker(Sweep* sw, uint64_t w){
+	while (true) {
+		Sweep_Job* next = NULL;
+		uint64_t next_lag = UINT64_MAX;
+		bool pending = false;
+
+		for (uint64_t j=w; j<sw->num_jobs; j+=sw->num_threads) {
+			Sweep_Job* job = &sw->jobs[j];
+			if (job->done) {
+				continue;
+			}
+			pending = true;
+			bool oldest;
+			uint64_t lag = sweep_job_lag(job, &oldest);
+			if (lag > SWEEP_MAX_LAG_CHUNKS && !oldest) {
+				continue;
+			}
+			if (next == NULL || lag < next_lag) {
+				next = job;
+				next_lag = lag;
+			}
+		}
+
+		if (!pending) {
+			return;
+		}
+
+		if (next == NULL) {
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			continue;
+		}
+
+		if (sim_run(next->sim, next->sim->cycle + SWEEP_SLICE_CYCLES)) {
+			sweep_job_finish(sw, next);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+void sweep_run(Sim_Config* base, const char* sweep_fname, uint64_t num_threads){
+	Sweep* sw = new Sweep();
+	sw->jobs_done = 0;
+	sweep_read_file(sw, base, sweep_fname);
+
+	if (num_threads == 0) {
+		num_threads = std::thread::hardware_concurrency();
+	}
+	if (num_threads == 0) {
+		num_threads = 1;
+	}
+	if (num_threads > sw->num_jobs) {
+		num_threads = sw->num_jobs;
+	}
+	sw->num_threads = num_threads;
+
+	// one decode per trace, shared by the same core of every configuration
+	sw->trace_share = (Trace_Share**)calloc(base->num_cores, sizeof(Trace_Share*));
+	for (uint64_t i=0; i<base->num_cores; i++) {
+		sw->trace_share[i] = trace_share_new(sim_open_trace(base, base->trace_filename[i]));
+	}
+
+	for (uint64_t j=0; j<sw->num_jobs; j++) {
+		sw->jobs[j].sim = sim_new(&sw->jobs[j].cfg, sw->trace_share);
+	}
+
+	printf("SWEEP %" PRIu64 " configurations, %" PRIu64 " worker threads\n", sw->num_jobs, num_threads);
+	fflush(stdout);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	std::vector<std::thread> workers;
+	for (uint64_t w=0; w<num_threads; w++) {
+		workers.push_back(std::thread(sweep_worker, sw, w));
+	}
+	for (uint64_t w=0; w<num_threads; w++) {
+		workers[w].join();
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("\nSWEEP_CONFIGS        \t : %10llu", (unsigned long long)sw->num_jobs);
+	printf("\nSWEEP_THREADS        \t : %10llu", (unsigned long long)num_threads);
+	printf("\nSWEEP_HOST_SECONDS   \t : %10.3f", secs);
+
+	for (uint64_t i=0; i<base->num_cores; i++) {
+		char header[256];
+		sprintf(header, "SWEEP_%llu", (unsigned long long)i);
+		trace_share_print_stats(sw->trace_share[i], header, stdout);
+		trace_share_close(sw->trace_share[i]);
+	}
+	printf("\n\n");
+}
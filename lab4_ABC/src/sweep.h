@@ -0,0 +1,21 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdint.h>
+
+#include "types.h"
+
+//////////////////////////////////////////////////////////////////
+// Sweep mode: run many memory-system configurations in one process.
+// Every trace is decoded once (see Trace_Share) and each configuration
+// gets its own cores and Memsys fed from that shared decode. Worker
+// threads each own a subset of the configurations and advance them in
+// slices of cycles, so no configuration runs far ahead of the others
+// and the decoded chunks they share stay bounded.
+//////////////////////////////////////////////////////////////////
+
+void sweep_run(Sim_Config* base, const char* sweep_fname, uint64_t num_threads);
+
+//////////////////////////////////////////////////////////////////
+
+#endif // SWEEP_H
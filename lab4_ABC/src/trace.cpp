@@ -0,0 +1,732 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sched.h>
+
+#include "trace.h"
+
+extern void die_message(const char* msg);
+
+#define TRACE_RAW_BLOCK_SIZE   (TRACE_BLOCK_RECORDS * TRACE_RAW_RECORD_SIZE)
+
+static uint64_t trace_now_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+static void trace_mmap(Trace* t, int fd, uint64_t header_size){
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		die_message("Unable to stat the trace file");
+	}
+
+	t->map_size = st.st_size;
+	if (t->map_size < header_size) {
+		printf("Trace file is %s\n", t->fname);
+		die_message("Truncated trace header");
+	}
+
+	void* map = mmap(NULL, t->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		printf("Trace file is %s\n", t->fname);
+		die_message("Unable to mmap the trace file");
+	}
+	madvise(map, t->map_size, MADV_SEQUENTIAL);
+	t->map = (const unsigned char*)map;
+}
+
+static void trace_open_map(Trace* t, int fd){
+	trace_mmap(t, fd, sizeof(Trace_Map_Header));
+
+	const Trace_Map_Header* hdr = (const Trace_Map_Header*)t->map;
+	uint32_t expected_size = (hdr->addr_width == 64) ? sizeof(Trace_Map_Record64) : sizeof(Trace_Map_Record32);
+	if (hdr->version != TRACE_MAP_VERSION || (hdr->addr_width != 32 && hdr->addr_width != 64) ||
+	    hdr->record_size != expected_size ||
+	    sizeof(Trace_Map_Header) + hdr->num_records * hdr->record_size > t->map_size) {
+		printf("Trace file is %s\n", t->fname);
+		die_message("Corrupt native trace header");
+	}
+
+	t->format = TRACE_FORMAT_MAP;
+	t->map_addr_width  = hdr->addr_width;
+	t->map_num_records = hdr->num_records;
+	t->map_pos = 0;
+}
+
+static void trace_open_col(Trace* t, int fd){
+	trace_mmap(t, fd, sizeof(Trace_Col_Header));
+
+	const Trace_Col_Header* hdr = (const Trace_Col_Header*)t->map;
+	if (hdr->version != TRACE_COL_VERSION || hdr->block_records == 0 ||
+	    hdr->index_offset % alignof(Trace_Col_Index) ||
+	    hdr->index_offset + (uint64_t)hdr->num_blocks * sizeof(Trace_Col_Index) > t->map_size) {
+		printf("Trace file is %s\n", t->fname);
+		die_message("Corrupt columnar trace header");
+	}
+
+	t->format    = TRACE_FORMAT_COLUMNAR;
+	t->col_hdr   = hdr;
+	t->col_index = (const Trace_Col_Index*)(t->map + hdr->index_offset);
+
+	for (uint32_t b=0; b<hdr->num_blocks; b++) {
+		const Trace_Col_Index* ix = &t->col_index[b];
+		if (ix->offset + ix->comp_size > hdr->index_offset) {
+			printf("Trace file is %s\n", t->fname);
+			die_message("Corrupt columnar trace index");
+		}
+		if (ix->raw_size > t->col_raw_size) {
+			t->col_raw_size = ix->raw_size;
+		}
+	}
+
+	t->col_raw = (unsigned char*)malloc(t->col_raw_size);
+	t->recs    = (Trace_Record*)malloc(hdr->block_records * sizeof(Trace_Record));
+}
+
+static void trace_open_gzip(Trace* t, int fd){
+	struct stat st;
+	if (fstat(fd, &st) == 0) {
+		t->gz_file_size = st.st_size;
+	}
+
+	// gzread() also passes through uncompressed files unchanged
+	if ((t->gz = gzopen(t->fname, "rb")) == NULL) {
+		printf("Trace file is %s\n", t->fname);
+		die_message("Unable to open the trace file");
+	}
+	gzbuffer(t->gz, 1<<20);
+
+	t->format = TRACE_FORMAT_GZIP;
+	t->raw  = (unsigned char*)malloc(TRACE_RAW_BLOCK_SIZE);
+	t->recs = (Trace_Record*)malloc(TRACE_BLOCK_RECORDS * sizeof(Trace_Record));
+}
+
+Trace* trace_open(const char* fname){
+	Trace* t = (Trace*)calloc(1, sizeof(Trace));
+	strncpy(t->fname, fname, sizeof(t->fname)-1);
+	t->remaining = UINT64_MAX;
+
+	int fd = open(fname, O_RDONLY);
+	if (fd < 0) {
+		printf("Trace file is %s\n", fname);
+		die_message("Unable to open the trace file");
+	}
+
+	uint32_t magic = 0;
+	if (pread(fd, &magic, sizeof(magic), 0) != sizeof(magic)) {
+		magic = 0;
+	}
+
+	switch (magic) {
+		case TRACE_MAP_MAGIC:
+			trace_open_map(t, fd);
+			break;
+		case TRACE_COL_MAGIC:
+			trace_open_col(t, fd);
+			break;
+		default:
+			trace_open_gzip(t, fd);
+			break;
+	}
+	close(fd);
+
+	return t;
+}
+
+////////////////////////////////////////////////////////////////////
+// Inflate the next block and parse it into the record buffer
+////////////////////////////////////////////////////////////////////
+
+static void trace_refill_gzip(Trace* t){
+	uint64_t start = trace_now_ns();
+
+	int bytes = gzread(t->gz, t->raw + t->raw_len, TRACE_RAW_BLOCK_SIZE - t->raw_len);
+	// a stream cut short reads as a plain end of file: only gzerror() tells
+	int errnum = Z_OK;
+	if (bytes <= 0) {
+		gzerror(t->gz, &errnum);
+	}
+	if (bytes < 0 || errnum != Z_OK) {
+		printf("Trace file is %s: %s\n", t->fname, gzerror(t->gz, &errnum));
+		die_message("Unable to decode the trace file");
+	}
+	t->raw_len += bytes;
+	__atomic_store_n(&t->gz_offset, (uint64_t)gzoffset(t->gz), __ATOMIC_RELAXED);
+
+	uint32_t n = t->raw_len / TRACE_RAW_RECORD_SIZE;
+	const unsigned char* p = t->raw;
+	for (uint32_t i=0; i<n; i++, p+=TRACE_RAW_RECORD_SIZE) {
+		Trace_Record* r = &t->recs[i];
+		uint32_t inst_addr, ldst_addr;
+		memcpy(&inst_addr, p,   4);
+		memcpy(&ldst_addr, p+5, 4);
+		r->inst_addr = inst_addr;
+		r->inst_type = p[4];
+		r->ldst_addr = ldst_addr;
+	}
+
+	// carry a partial record over to the next block
+	uint64_t used = (uint64_t)n * TRACE_RAW_RECORD_SIZE;
+	memmove(t->raw, t->raw + used, t->raw_len - used);
+	t->raw_len -= used;
+
+	t->num_recs = n;
+	t->rec_pos  = 0;
+
+	// a trailing partial record is dropped, same as the old fread() path
+	if (n == 0) {
+		t->eof = true;
+	}
+
+	t->stat_decode_ns += trace_now_ns() - start;
+}
+
+////////////////////////////////////////////////////////////////////
+// Columnar blocks: inflate block b and undo the delta/varint coding
+////////////////////////////////////////////////////////////////////
+
+static uint64_t trace_col_varint(Trace* t, const unsigned char** p, const unsigned char* end){
+	uint64_t v = 0;
+	for (uint32_t shift=0; shift<64; shift+=7) {
+		if (*p == end) {
+			break;
+		}
+		unsigned char byte = *(*p)++;
+		v |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			// zigzag back to a signed delta
+			return (v >> 1) ^ (~(v & 1) + 1);
+		}
+	}
+	printf("Trace file is %s\n", t->fname);
+	die_message("Corrupt columnar trace block");
+	return 0;
+}
+
+static void trace_col_decode_block(Trace* t, uint32_t b){
+	uint64_t start = trace_now_ns();
+	const Trace_Col_Index* ix = &t->col_index[b];
+
+	uLongf raw_size = t->col_raw_size;
+	Trace_Col_Block blk;
+	if (uncompress(t->col_raw, &raw_size, t->map + ix->offset, ix->comp_size) != Z_OK ||
+	    raw_size != ix->raw_size || raw_size < sizeof(blk)) {
+		printf("Trace file is %s\n", t->fname);
+		die_message("Unable to inflate columnar trace block");
+	}
+
+	memcpy(&blk, t->col_raw, sizeof(blk));
+	if (blk.num_records > t->col_hdr->block_records || blk.inst_type_bytes != blk.num_records ||
+	    sizeof(blk) + (uint64_t)blk.inst_addr_bytes + blk.inst_type_bytes + blk.ldst_addr_bytes != raw_size) {
+		printf("Trace file is %s\n", t->fname);
+		die_message("Corrupt columnar trace block");
+	}
+
+	const unsigned char* inst_addr_p   = t->col_raw + sizeof(blk);
+	const unsigned char* inst_addr_end = inst_addr_p + blk.inst_addr_bytes;
+	const unsigned char* inst_type_p   = inst_addr_end;
+	const unsigned char* ldst_addr_p   = inst_type_p + blk.inst_type_bytes;
+	const unsigned char* ldst_addr_end = ldst_addr_p + blk.ldst_addr_bytes;
+
+	uint64_t inst_addr = 0, ldst_addr = 0;
+	for (uint32_t i=0; i<blk.num_records; i++) {
+		Trace_Record* r = &t->recs[i];
+		inst_addr += trace_col_varint(t, &inst_addr_p, inst_addr_end);
+		ldst_addr += trace_col_varint(t, &ldst_addr_p, ldst_addr_end);
+		r->inst_addr = inst_addr;
+		r->inst_type = inst_type_p[i];
+		r->ldst_addr = ldst_addr;
+	}
+
+	t->num_recs = blk.num_records;
+	t->rec_pos  = 0;
+	t->col_next_block = b+1;
+
+	t->stat_decode_ns += trace_now_ns() - start;
+}
+
+static void trace_refill_col(Trace* t){
+	if (t->col_next_block >= t->col_hdr->num_blocks) {
+		t->num_recs = 0;
+		t->rec_pos  = 0;
+		t->eof = true;
+		return;
+	}
+	trace_col_decode_block(t, t->col_next_block);
+}
+
+////////////////////////////////////////////////////////////////////
+// Decode the next record on the calling thread
+////////////////////////////////////////////////////////////////////
+
+static bool trace_read_map(Trace* t, Trace_Record* rec){
+	if (t->map_pos == t->map_num_records) {
+		return false;
+	}
+
+	const unsigned char* base = t->map + sizeof(Trace_Map_Header);
+	if (t->map_addr_width == 32) {
+		const Trace_Map_Record32* r = (const Trace_Map_Record32*)base + t->map_pos;
+		rec->inst_addr = r->inst_addr;
+		rec->inst_type = r->inst_type;
+		rec->ldst_addr = r->ldst_addr;
+	}
+	else {
+		const Trace_Map_Record64* r = (const Trace_Map_Record64*)base + t->map_pos;
+		rec->inst_addr = r->inst_addr;
+		rec->inst_type = r->inst_type;
+		rec->ldst_addr = r->ldst_addr;
+	}
+
+	t->map_pos++;
+	t->stat_records++;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////
+// Shared traces: readers walk a list of decoded chunks. The chunk after
+// the newest one is decoded from the source by whichever reader needs it
+// first; a chunk is freed when the last reader moves past it.
+////////////////////////////////////////////////////////////////////
+
+static void trace_share_decode(Trace_Share* s){
+	Trace_Share_Chunk* ch = (Trace_Share_Chunk*)calloc(1, sizeof(Trace_Share_Chunk));
+	ch->recs = (Trace_Record*)malloc(TRACE_BLOCK_RECORDS * sizeof(Trace_Record));
+
+	while (ch->num_recs < TRACE_BLOCK_RECORDS && trace_read(s->src, &ch->recs[ch->num_recs])) {
+		ch->num_recs++;
+	}
+
+	if (ch->num_recs == 0) {
+		s->eof = true;
+		free(ch->recs);
+		free(ch);
+		return;
+	}
+
+	ch->readers_left = s->num_readers;
+	s->chunks.push_back(ch);
+	s->stat_chunks++;
+	if (s->chunks.size() > s->stat_max_buffered) {
+		s->stat_max_buffered = s->chunks.size();
+	}
+}
+
+// caller holds s->lock
+static void trace_share_release(Trace_Share* s, Trace_Share_Chunk* ch){
+	ch->readers_left--;
+	while (!s->chunks.empty() && s->chunks.front()->readers_left == 0) {
+		Trace_Share_Chunk* old = s->chunks.front();
+		s->chunks.pop_front();
+		s->first_chunk++;
+		free(old->recs);
+		free(old);
+	}
+}
+
+static void trace_refill_shared(Trace* t){
+	Trace_Share* s = t->share;
+	std::lock_guard<std::mutex> guard(s->lock);
+
+	if (t->share_chunk) {
+		trace_share_release(s, t->share_chunk);
+		t->share_chunk = NULL;
+	}
+
+	t->recs     = NULL;
+	t->num_recs = 0;
+	t->rec_pos  = 0;
+
+	while (t->share_next >= s->first_chunk + s->chunks.size()) {
+		if (s->eof) {
+			t->eof = true;
+			return;
+		}
+		trace_share_decode(s);
+	}
+
+	t->share_chunk = s->chunks[t->share_next - s->first_chunk];
+	t->share_next++;
+	t->recs     = t->share_chunk->recs;
+	t->num_recs = t->share_chunk->num_recs;
+}
+
+static bool trace_next(Trace* t, Trace_Record* rec){
+	if (t->format == TRACE_FORMAT_MAP) {
+		return trace_read_map(t, rec);
+	}
+
+	while (t->rec_pos == t->num_recs) {
+		if (t->eof) {
+			return false;
+		}
+		if (t->format == TRACE_FORMAT_COLUMNAR) {
+			trace_refill_col(t);
+		}
+		else if (t->format == TRACE_FORMAT_SHARED) {
+			trace_refill_shared(t);
+		}
+		else {
+			trace_refill_gzip(t);
+		}
+	}
+
+	*rec = t->recs[t->rec_pos++];
+	t->stat_records++;
+	return true;
+}
+
+static bool trace_read_direct(Trace* t, Trace_Record* rec){
+	if (t->remaining == 0 || !trace_next(t, rec)) {
+		return false;
+	}
+	t->remaining--;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////
+// Position the trace so the next record read is record inst_num.
+// Columnar traces jump straight to the right block; the other
+// formats get there by decoding (gzip) or indexing (native).
+// Must be called before trace_start_prefetch().
+////////////////////////////////////////////////////////////////////
+
+void trace_seek(Trace* t, uint64_t inst_num){
+	assert(t->ring == NULL && t->share == NULL);
+	t->skip_records = inst_num;
+
+	if (t->format == TRACE_FORMAT_MAP) {
+		t->map_pos = (inst_num < t->map_num_records) ? inst_num : t->map_num_records;
+		return;
+	}
+
+	if (t->format == TRACE_FORMAT_COLUMNAR) {
+		const Trace_Col_Header* hdr = t->col_hdr;
+		if (inst_num >= hdr->num_records) {
+			t->col_next_block = hdr->num_blocks;
+			t->num_recs = 0;
+			t->rec_pos  = 0;
+			t->eof = true;
+			return;
+		}
+
+		// last block whose first record is <= inst_num
+		uint32_t lo = 0, hi = hdr->num_blocks;
+		while (hi - lo > 1) {
+			uint32_t mid = (lo + hi) / 2;
+			if (t->col_index[mid].first_record <= inst_num) {
+				lo = mid;
+			}
+			else {
+				hi = mid;
+			}
+		}
+		trace_col_decode_block(t, lo);
+		t->rec_pos = inst_num - t->col_index[lo].first_record;
+		return;
+	}
+
+	Trace_Record rec;
+	for (uint64_t i=0; i<inst_num; i++) {
+		if (!trace_next(t, &rec)) {
+			break;
+		}
+	}
+	t->gz_start_offset = t->gz_offset;
+}
+
+////////////////////////////////////////////////////////////////////
+// Report the end of the trace after num_records more records
+////////////////////////////////////////////////////////////////////
+
+void trace_set_limit(Trace* t, uint64_t num_records){
+	assert(t->ring == NULL);
+	t->remaining = num_records;
+	t->limit_records = num_records;
+}
+
+////////////////////////////////////////////////////////////////////
+// Prefetch ring: the producer thread runs trace_read_direct() ahead of
+// the simulation and pushes records; trace_read() pops them.
+////////////////////////////////////////////////////////////////////
+
+static void trace_ring_wait(uint32_t* spins){
+	// spin briefly, then give the other side the CPU
+	if (++(*spins) > 64) {
+		sched_yield();
+	}
+}
+
+static void trace_ring_produce(Trace* t){
+	Trace_Ring* r = t->ring;
+	uint64_t tail = r->tail.load(std::memory_order_relaxed);
+	uint64_t cached_head = r->head.load(std::memory_order_acquire);
+	Trace_Record rec;
+
+	while (trace_read_direct(t, &rec)) {
+		if (tail - cached_head > r->mask) {
+			r->stat_producer_stalls++;
+			uint32_t spins = 0;
+			while (tail - (cached_head = r->head.load(std::memory_order_acquire)) > r->mask) {
+				if (r->stop.load(std::memory_order_relaxed)) {
+					return;
+				}
+				trace_ring_wait(&spins);
+			}
+		}
+		r->slots[tail & r->mask] = rec;
+		r->tail.store(++tail, std::memory_order_release);
+	}
+
+	r->producer_done.store(true, std::memory_order_release);
+}
+
+static bool trace_ring_pop(Trace* t, Trace_Record* rec){
+	Trace_Ring* r = t->ring;
+	uint64_t head = r->head.load(std::memory_order_relaxed);
+
+	if (head == r->cached_tail) {
+		r->cached_tail = r->tail.load(std::memory_order_acquire);
+		if (head == r->cached_tail) {
+			r->stat_consumer_stalls++;
+			uint32_t spins = 0;
+			while (head == (r->cached_tail = r->tail.load(std::memory_order_acquire))) {
+				if (r->producer_done.load(std::memory_order_acquire)) {
+					// the producer may have pushed between our two loads
+					r->cached_tail = r->tail.load(std::memory_order_acquire);
+					if (head == r->cached_tail) {
+						return false;
+					}
+					break;
+				}
+				trace_ring_wait(&spins);
+			}
+		}
+	}
+
+	r->stat_pops++;
+	r->stat_occupancy_sum += r->cached_tail - head;
+
+	*rec = r->slots[head & r->mask];
+	r->head.store(head+1, std::memory_order_release);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////
+// ring_entries is rounded up to a power of two
+////////////////////////////////////////////////////////////////////
+
+void trace_start_prefetch(Trace* t, uint64_t ring_entries){
+	assert(t->ring == NULL);
+
+	uint64_t entries = 1;
+	while (entries < ring_entries) {
+		entries <<= 1;
+	}
+
+	// head and tail sit on cache lines of their own, which plain new
+	// does not keep to before C++17
+	Trace_Ring* r = (Trace_Ring*)aligned_alloc(alignof(Trace_Ring), sizeof(Trace_Ring));
+	new (r) Trace_Ring();
+	r->slots = (Trace_Record*)malloc(entries * sizeof(Trace_Record));
+	r->mask  = entries - 1;
+	r->head.store(0);
+	r->tail.store(0);
+	r->producer_done.store(false);
+	r->stop.store(false);
+
+	t->ring = r;
+	r->producer = std::thread(trace_ring_produce, t);
+}
+
+////////////////////////////////////////////////////////////////////
+// src is fully set up (seek, limit, prefetch) before it is shared.
+// Readers start at the first record, so all of them must be opened
+// before the first chunk is released.
+////////////////////////////////////////////////////////////////////
+
+Trace_Share* trace_share_new(Trace* src){
+	Trace_Share* s = new Trace_Share();
+	s->src = src;
+	s->first_chunk = 0;
+	s->num_readers = 0;
+	s->eof = false;
+	s->stat_chunks = 0;
+	s->stat_max_buffered = 0;
+	return s;
+}
+
+Trace* trace_open_shared(Trace_Share* s){
+	Trace* t = (Trace*)calloc(1, sizeof(Trace));
+	snprintf(t->fname, sizeof(t->fname), "%s", s->src->fname);
+	t->format    = TRACE_FORMAT_SHARED;
+	t->remaining = UINT64_MAX;
+	t->share     = s;
+
+	std::lock_guard<std::mutex> guard(s->lock);
+	assert(s->first_chunk == 0);
+	for (Trace_Share_Chunk* ch : s->chunks) {
+		ch->readers_left++;
+	}
+	s->num_readers++;
+	return t;
+}
+
+////////////////////////////////////////////////////////////////////
+// How many decoded chunks a reader is ahead of the slowest reader:
+// 0 if it holds (or is yet to read) the oldest chunk
+////////////////////////////////////////////////////////////////////
+
+uint64_t trace_share_lag(Trace* t){
+	Trace_Share* s = t->share;
+	std::lock_guard<std::mutex> guard(s->lock);
+	uint64_t current = t->share_chunk ? t->share_next - 1 : t->share_next;
+	return current - s->first_chunk;
+}
+
+void trace_share_close(Trace_Share* s){
+	assert(s->num_readers == 0);
+	for (Trace_Share_Chunk* ch : s->chunks) {
+		free(ch->recs);
+		free(ch);
+	}
+	trace_close(s->src);
+	delete s;
+}
+
+////////////////////////////////////////////////////////////////////
+// Returns false once the trace is exhausted
+////////////////////////////////////////////////////////////////////
+
+bool trace_read(Trace* t, Trace_Record* rec){
+	if (t->ring) {
+		return trace_ring_pop(t, rec);
+	}
+	return trace_read_direct(t, rec);
+}
+
+////////////////////////////////////////////////////////////////////
+// Fraction of the trace a reader is through after records_read
+// records, for progress reports; -1 if the length is unknown. Gzip
+// traces only know how much of the compressed file is consumed,
+// which runs ahead of the reader by the decode buffers.
+////////////////////////////////////////////////////////////////////
+
+double trace_fraction_done(Trace* t, uint64_t records_read){
+	if (t->share) {
+		return trace_fraction_done(t->share->src, records_read);
+	}
+
+	uint64_t length = 0;
+	if (t->format == TRACE_FORMAT_MAP) {
+		length = t->map_num_records;
+	}
+	else if (t->format == TRACE_FORMAT_COLUMNAR) {
+		length = t->col_hdr->num_records;
+	}
+	length = (length > t->skip_records) ? length - t->skip_records : 0;
+
+	if (t->limit_records && (length == 0 || t->limit_records < length)) {
+		length = t->limit_records;
+	}
+
+	if (length) {
+		return (records_read < length) ? (double)records_read / (double)length : 1.0;
+	}
+
+	if (t->format == TRACE_FORMAT_GZIP && t->gz_file_size > t->gz_start_offset) {
+		uint64_t offset = __atomic_load_n(&t->gz_offset, __ATOMIC_RELAXED);
+		return (double)(offset - t->gz_start_offset) / (double)(t->gz_file_size - t->gz_start_offset);
+	}
+	return -1;
+}
+
+////////////////////////////////////////////////////////////////////
+// Records decoded per host second (0 for native traces: nothing to decode)
+////////////////////////////////////////////////////////////////////
+
+double trace_decode_rate(Trace* t){
+	if (t->stat_decode_ns == 0) {
+		return 0;
+	}
+	return (double)(t->stat_records) * 1e9 / (double)(t->stat_decode_ns);
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+void trace_print_stats(Trace* t, char* header, FILE* out){
+	fprintf(out, "\n%s_TRACE_RECS_PER_SEC\t : %10.0f", header, trace_decode_rate(t));
+
+	if (t->ring) {
+		Trace_Ring* r = t->ring;
+		double avg_occupancy = 0;
+		if (r->stat_pops) {
+			avg_occupancy = (double)(r->stat_occupancy_sum) / (double)(r->stat_pops);
+		}
+		fprintf(out, "\n%s_TRACE_RING_ENTRIES  \t : %10llu", header, (unsigned long long)(r->mask+1));
+		fprintf(out, "\n%s_TRACE_RING_AVG_OCC  \t : %10.3f", header, avg_occupancy);
+		fprintf(out, "\n%s_TRACE_RING_CONS_STALL\t : %10llu", header, (unsigned long long)r->stat_consumer_stalls);
+		fprintf(out, "\n%s_TRACE_RING_PROD_STALL\t : %10llu", header, (unsigned long long)r->stat_producer_stalls);
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+void trace_share_print_stats(Trace_Share* s, char* header, FILE* out){
+	trace_print_stats(s->src, header, out);
+	fprintf(out, "\n%s_TRACE_SHARE_CHUNKS  \t : %10llu", header, (unsigned long long)s->stat_chunks);
+	fprintf(out, "\n%s_TRACE_SHARE_MAX_BUF \t : %10llu", header, (unsigned long long)s->stat_max_buffered);
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+void trace_close(Trace* t){
+	if (t->share) {
+		// let the other readers free the chunks this one will never read
+		Trace_Share* s = t->share;
+		std::lock_guard<std::mutex> guard(s->lock);
+		if (t->share_chunk) {
+			trace_share_release(s, t->share_chunk);
+		}
+		while (t->share_next < s->first_chunk + s->chunks.size()) {
+			Trace_Share_Chunk* ch = s->chunks[t->share_next - s->first_chunk];
+			t->share_next++;
+			trace_share_release(s, ch);
+		}
+		s->num_readers--;
+		free(t);
+		return;
+	}
+
+	if (t->ring) {
+		t->ring->stop.store(true);
+		t->ring->producer.join();
+		free(t->ring->slots);
+		t->ring->~Trace_Ring();
+		free(t->ring);
+	}
+
+	if (t->format == TRACE_FORMAT_GZIP) {
+		gzclose(t->gz);
+		free(t->raw);
+	}
+	else {
+		munmap((void*)t->map, t->map_size);
+	}
+	free(t->col_raw);
+	free(t->recs);
+	free(t);
+}
@@ -0,0 +1,255 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <zlib.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <deque>
+
+#include "types.h"
+
+//////////////////////////////////////////////////////////////////
+// In-process trace decoder.
+// The .mtr.gz traces are a stream of packed 9-byte records
+// {inst_addr:4, inst_type:1, ldst_addr:4}. Instead of piping through
+// "gunzip -c" and doing three fread() calls per instruction, we inflate
+// large blocks with zlib and parse them into a per-core record buffer.
+//
+// Traces converted with trace_convert use a native format instead: a
+// header followed by fixed-width, aligned records that are mmap()ed and
+// walked in place. trace_open() picks the format from the file magic.
+//
+// trace_convert -columnar writes a compact, seekable container instead:
+// blocks of TRACE_BLOCK_RECORDS records stored as separate delta/varint
+// encoded columns, each block compressed on its own, plus an index of
+// block offsets so trace_seek() can start at any instruction.
+//
+// Optionally a producer thread decodes ahead into a lock-free
+// single-producer/single-consumer ring (trace_start_prefetch()), so the
+// simulation thread only pops already-parsed records.
+//
+// A sweep (sweep.cpp) runs many configurations over the same traces.
+// Each trace is then decoded once into a Trace_Share, and every
+// simulated core reads it through its own trace_open_shared() handle.
+// Decoded chunks are kept until the slowest reader has moved past them.
+//////////////////////////////////////////////////////////////////
+
+#define TRACE_RAW_RECORD_SIZE   9
+#define TRACE_BLOCK_RECORDS     (64*1024)
+
+#define TRACE_MAP_MAGIC         0x3152544d  // "MTR1"
+#define TRACE_MAP_VERSION       1
+
+#define TRACE_COL_MAGIC         0x3143544d  // "MTC1"
+#define TRACE_COL_VERSION       1
+
+typedef struct Trace_Record Trace_Record;
+typedef struct Trace_Map_Header Trace_Map_Header;
+typedef struct Trace_Map_Record32 Trace_Map_Record32;
+typedef struct Trace_Map_Record64 Trace_Map_Record64;
+typedef struct Trace_Col_Header Trace_Col_Header;
+typedef struct Trace_Col_Index Trace_Col_Index;
+typedef struct Trace_Col_Block Trace_Col_Block;
+typedef struct Trace_Ring Trace_Ring;
+typedef struct Trace_Share_Chunk Trace_Share_Chunk;
+typedef struct Trace_Share Trace_Share;
+typedef struct Trace Trace;
+
+typedef enum Trace_Format_Enum {
+	TRACE_FORMAT_GZIP=0,
+	TRACE_FORMAT_MAP=1,
+	TRACE_FORMAT_COLUMNAR=2,
+	TRACE_FORMAT_SHARED=3,
+} Trace_Format;
+
+struct Trace_Record {
+	uint64_t inst_addr;
+	uint64_t ldst_addr;
+	uint8_t  inst_type;
+};
+
+// Native format: 64-byte header, then num_records records of record_size
+// bytes each. addr_width selects the record layout below.
+struct Trace_Map_Header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t addr_width;   // 32 or 64
+	uint32_t record_size;
+	uint32_t reserved;
+	uint64_t num_records;
+	uint8_t  pad[40];
+};
+
+struct Trace_Map_Record32 {
+	uint32_t inst_addr;
+	uint32_t ldst_addr;
+	uint8_t  inst_type;
+	uint8_t  pad[3];
+};
+
+struct Trace_Map_Record64 {
+	uint64_t inst_addr;
+	uint64_t ldst_addr;
+	uint8_t  inst_type;
+	uint8_t  pad[7];
+};
+
+// Columnar format: 64-byte header, compressed blocks, then num_blocks
+// index entries at index_offset, which is padded to the index's
+// alignment so the entries can be read in place from the mapping.
+// Block b holds records [b*block_records, (b+1)*block_records).
+struct Trace_Col_Header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t block_records;
+	uint32_t num_blocks;
+	uint64_t num_records;
+	uint64_t index_offset;
+	uint8_t  pad[32];
+};
+
+struct Trace_Col_Index {
+	uint64_t first_record;
+	uint64_t offset;
+	uint32_t comp_size;
+	uint32_t raw_size;
+};
+
+// Start of each inflated block; the columns follow back to back.
+// inst_addr and ldst_addr are zigzag varints of the delta to the previous
+// record in the same block, inst_type is one byte per record.
+struct Trace_Col_Block {
+	uint32_t num_records;
+	uint32_t inst_addr_bytes;
+	uint32_t inst_type_bytes;
+	uint32_t ldst_addr_bytes;
+};
+
+struct Trace_Ring {
+	Trace_Record* slots;
+	uint64_t mask;
+
+	// head is only written by the consumer, tail only by the producer
+	alignas(64) std::atomic<uint64_t> head;
+	alignas(64) std::atomic<uint64_t> tail;
+	alignas(64) std::atomic<bool> producer_done;
+	std::atomic<bool> stop;
+
+	std::thread producer;
+
+	// consumer-side copy of tail, refreshed only when the ring looks empty
+	uint64_t cached_tail;
+
+	// stats
+	uint64_t stat_pops;
+	uint64_t stat_occupancy_sum;
+	uint64_t stat_consumer_stalls;   // pops that found the ring empty
+	uint64_t stat_producer_stalls;   // pushes that found the ring full
+};
+
+// TRACE_BLOCK_RECORDS decoded records, freed once every reader is done with them
+struct Trace_Share_Chunk {
+	Trace_Record* recs;
+	uint32_t num_recs;
+	uint64_t readers_left;
+};
+
+struct Trace_Share {
+	Trace* src;
+
+	// everything below is guarded by lock
+	std::mutex lock;
+	std::deque<Trace_Share_Chunk*> chunks;
+	uint64_t first_chunk;    // chunk number of chunks.front()
+	uint64_t num_readers;    // open trace_open_shared() handles
+	bool eof;
+
+	// stats
+	uint64_t stat_chunks;
+	uint64_t stat_max_buffered;
+};
+
+struct Trace {
+	char fname[1024];
+	Trace_Format format;
+
+	// TRACE_FORMAT_GZIP
+	gzFile gz;
+	uint64_t gz_file_size;
+	uint64_t gz_offset;        // compressed bytes consumed, updated by the decoding thread
+	uint64_t gz_start_offset;  // gz_offset once trace_seek() is done
+
+	// raw inflated bytes; a partial record may be carried over between blocks
+	unsigned char* raw;
+	uint64_t raw_len;
+
+	// parsed records, consumed by trace_read()
+	Trace_Record* recs;
+	uint32_t num_recs;
+	uint32_t rec_pos;
+
+	bool eof;
+
+	// TRACE_FORMAT_MAP / TRACE_FORMAT_COLUMNAR: the mmap()ed file
+	const unsigned char* map;
+	uint64_t map_size;
+
+	// TRACE_FORMAT_MAP
+	uint64_t map_num_records;
+	uint64_t map_pos;
+	uint32_t map_addr_width;
+
+	// TRACE_FORMAT_COLUMNAR
+	const Trace_Col_Header* col_hdr;
+	const Trace_Col_Index* col_index;
+	uint32_t col_next_block;
+	unsigned char* col_raw;
+	uint64_t col_raw_size;
+
+	// records left before trace_read() reports the end (trace_set_limit())
+	uint64_t remaining;
+
+	// as passed to trace_seek() / trace_set_limit(), for trace_fraction_done()
+	uint64_t skip_records;
+	uint64_t limit_records;
+
+	// set by trace_start_prefetch()
+	Trace_Ring* ring;
+
+	// TRACE_FORMAT_SHARED: recs points into share_chunk
+	Trace_Share* share;
+	Trace_Share_Chunk* share_chunk;
+	uint64_t share_next;     // number of the next chunk to read
+
+	// stats
+	uint64_t stat_records;
+	uint64_t stat_decode_ns;
+};
+
+//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+Trace* trace_open(const char* fname);
+bool trace_read(Trace* t, Trace_Record* rec);
+void trace_close(Trace* t);
+void trace_start_prefetch(Trace* t, uint64_t ring_entries);
+void trace_seek(Trace* t, uint64_t inst_num);
+void trace_set_limit(Trace* t, uint64_t num_records);
+
+Trace_Share* trace_share_new(Trace* src);
+Trace* trace_open_shared(Trace_Share* s);
+uint64_t trace_share_lag(Trace* t);
+void trace_share_close(Trace_Share* s);
+
+double trace_fraction_done(Trace* t, uint64_t records_read);
+double trace_decode_rate(Trace* t);
+void trace_print_stats(Trace* t, char* header, FILE* out);
+void trace_share_print_stats(Trace_Share* s, char* header, FILE* out);
+
+//////////////////////////////////////////////////////////////////
+
+#endif // TRACE_H
@@ -0,0 +1,200 @@
+ /*************************************************************************
+ * File         : trace_convert.cpp
+ * Description  : Convert .mtr.gz traces into the native mmap()able format
+ *                or the compact, seekable columnar format
+ *************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "trace.h"
+
+void die_message(const char* msg){
+	printf("Error! %s. Exiting...\n", msg);
+	exit(1);
+}
+
+void die_usage(){
+	printf("Usage : trace_convert [-columnar] <in trace> <out trace>\n");
+	printf("   Options\n");
+	printf("      -columnar        Write the seekable delta/varint columnar format (.mtrc) instead of\n");
+	printf("                       the fixed-width mmap()able format (.mtrb)\n");
+	exit(0);
+}
+
+////////////////////////////////////////////////////////////////////
+// Fixed-width native format
+////////////////////////////////////////////////////////////////////
+
+uint64_t convert_map(Trace* in, FILE* out){
+	// header is rewritten with the final record count once we are done
+	Trace_Map_Header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic       = TRACE_MAP_MAGIC;
+	hdr.version     = TRACE_MAP_VERSION;
+	hdr.addr_width  = 32;
+	hdr.record_size = sizeof(Trace_Map_Record32);
+	fwrite(&hdr, sizeof(hdr), 1, out);
+
+	Trace_Record rec;
+	Trace_Map_Record32 r;
+	memset(&r, 0, sizeof(r));
+	while (trace_read(in, &rec)) {
+		if ((rec.inst_addr >> 32) || (rec.ldst_addr >> 32)) {
+			die_message("Address does not fit in 32 bits");
+		}
+		r.inst_addr = rec.inst_addr;
+		r.ldst_addr = rec.ldst_addr;
+		r.inst_type = rec.inst_type;
+		fwrite(&r, sizeof(r), 1, out);
+		hdr.num_records++;
+	}
+
+	fseek(out, 0, SEEK_SET);
+	fwrite(&hdr, sizeof(hdr), 1, out);
+	return hdr.num_records;
+}
+
+////////////////////////////////////////////////////////////////////
+// Columnar format
+////////////////////////////////////////////////////////////////////
+
+unsigned char* put_varint(unsigned char* p, uint64_t prev, uint64_t cur){
+	int64_t delta = (int64_t)(cur - prev);
+	uint64_t v = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+	while (v >= 0x80) {
+		*p++ = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (unsigned char)v;
+	return p;
+}
+
+void convert_col_block(FILE* out, Trace_Record* recs, uint32_t n, Trace_Col_Index* ix,
+                       unsigned char* raw, unsigned char* comp, uLong comp_bound){
+	Trace_Col_Block blk;
+	unsigned char* inst_addr_col = raw + sizeof(blk);
+	unsigned char* p = inst_addr_col;
+	for (uint32_t i=0; i<n; i++) {
+		p = put_varint(p, i ? recs[i-1].inst_addr : 0, recs[i].inst_addr);
+	}
+	blk.inst_addr_bytes = p - inst_addr_col;
+
+	for (uint32_t i=0; i<n; i++) {
+		*p++ = recs[i].inst_type;
+	}
+	blk.inst_type_bytes = n;
+
+	unsigned char* ldst_addr_col = p;
+	for (uint32_t i=0; i<n; i++) {
+		p = put_varint(p, i ? recs[i-1].ldst_addr : 0, recs[i].ldst_addr);
+	}
+	blk.ldst_addr_bytes = p - ldst_addr_col;
+
+	blk.num_records = n;
+	memcpy(raw, &blk, sizeof(blk));
+
+	uLongf comp_size = comp_bound;
+	if (compress2(comp, &comp_size, raw, p - raw, Z_BEST_COMPRESSION) != Z_OK) {
+		die_message("Unable to compress a trace block");
+	}
+
+	ix->offset    = ftell(out);
+	ix->comp_size = comp_size;
+	ix->raw_size  = p - raw;
+	fwrite(comp, 1, comp_size, out);
+}
+
+uint64_t convert_col(Trace* in, FILE* out){
+	Trace_Col_Header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic         = TRACE_COL_MAGIC;
+	hdr.version       = TRACE_COL_VERSION;
+	hdr.block_records = TRACE_BLOCK_RECORDS;
+	fwrite(&hdr, sizeof(hdr), 1, out);
+
+	// worst case: two 10-byte varints and a type byte per record
+	uLong raw_bound  = sizeof(Trace_Col_Block) + (uint64_t)hdr.block_records * 21;
+	uLong comp_bound = compressBound(raw_bound);
+	unsigned char* raw  = (unsigned char*)malloc(raw_bound);
+	unsigned char* comp = (unsigned char*)malloc(comp_bound);
+	Trace_Record* recs  = (Trace_Record*)malloc(hdr.block_records * sizeof(Trace_Record));
+
+	uint32_t max_blocks = 1024;
+	Trace_Col_Index* index = (Trace_Col_Index*)malloc(max_blocks * sizeof(Trace_Col_Index));
+
+	uint32_t n = 0;
+	bool more = true;
+	while (more) {
+		more = trace_read(in, &recs[n]);
+		if (more) {
+			n++;
+		}
+		if (n == hdr.block_records || (!more && n)) {
+			if (hdr.num_blocks == max_blocks) {
+				max_blocks *= 2;
+				index = (Trace_Col_Index*)realloc(index, max_blocks * sizeof(Trace_Col_Index));
+			}
+			Trace_Col_Index* ix = &index[hdr.num_blocks++];
+			ix->first_record = hdr.num_records;
+			convert_col_block(out, recs, n, ix, raw, comp, comp_bound);
+			hdr.num_records += n;
+			n = 0;
+		}
+	}
+
+	hdr.index_offset = ftell(out);
+	while (hdr.index_offset % alignof(Trace_Col_Index)) {
+		fputc(0, out);
+		hdr.index_offset++;
+	}
+	fwrite(index, sizeof(Trace_Col_Index), hdr.num_blocks, out);
+
+	fseek(out, 0, SEEK_SET);
+	fwrite(&hdr, sizeof(hdr), 1, out);
+
+	free(raw);
+	free(comp);
+	free(recs);
+	free(index);
+	return hdr.num_records;
+}
+
+////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	bool columnar = false;
+	int argi = 1;
+
+	if (argi < argc && !strcmp(argv[argi], "-columnar")) {
+		columnar = true;
+		argi++;
+	}
+	if (argc - argi != 2) {
+		die_usage();
+	}
+
+	Trace* in = trace_open(argv[argi]);
+
+	FILE* out = fopen(argv[argi+1], "wb");
+	if (out == NULL) {
+		die_message("Unable to create the output file");
+	}
+
+	uint64_t num_records = columnar ? convert_col(in, out) : convert_map(in, out);
+
+	fseek(out, 0, SEEK_END);
+	long out_size = ftell(out);
+	if (fclose(out) != 0) {
+		die_message("Unable to write the output file");
+	}
+
+	printf("%s: %" PRIu64 " records, %ld bytes (%.0f records/sec decode)\n",
+	       argv[argi+1], num_records, out_size, trace_decode_rate(in));
+	trace_close(in);
+	return 0;
+}
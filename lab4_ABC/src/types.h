@@ -3,8 +3,6 @@
 #define HIT   1
 #define MISS  0
 
-#define MAX_CORES 2
-
 // Precision for PrintStats
 #define UNS_PREC " %8llu"
 #define DBL_PREC "%9.3f"
@@ -33,6 +31,97 @@ typedef enum MODE_Enum {
     SIM_MODE_E=5
 } MODE;
 
+/**************************************************************************************/
+// Everything that configures one simulation. Each simulation in the
+// process (see sweep.cpp) owns its own copy.
+/**************************************************************************************/
+
+typedef struct Sim_Config Sim_Config;
+typedef struct Hier_Config Hier_Config;
+
+struct Sim_Config {
+    MODE     sim_mode;
+    uint64_t cache_linesize;
+    uint64_t repl_policy;      // L1 caches, a Cache_Repl (see cache.h)
+    uint64_t repl_seed;        // RND, BRRIP and DRRIP random streams
+
+    uint64_t dcache_size;
+    uint64_t dcache_assoc;
+    uint64_t icache_size;
+    uint64_t icache_assoc;
+
+    uint64_t l2cache_size;
+    uint64_t l2cache_assoc;
+    uint64_t l2cache_repl;     // UINT64_MAX: repl_policy in modes A-C, FIFO in modes D-F
+    uint64_t l2cache_inclusion; // a Hier_Inclusion (see hier.h) towards the L1s
+
+    uint64_t dcache_prefetch;  // a Prefetch_Type (see prefetch.h) for the L1 dcache(s)
+    uint64_t dcache_prefetch_degree;
+    uint64_t dcache_prefetch_distance;
+    uint64_t dcache_victim_entries; // victim cache of the L1 dcache(s), 0: none
+    uint64_t dcache_victim_latency;
+    uint64_t dcache_mshrs;     // MSHRs of the L1 dcache(s), 0: not modeled (see mshr.h)
+    uint64_t l2cache_mshrs;    // and of the L2
+    bool     dcache_no_write_allocate; // write policies of the L1 dcache(s) (see hier.h)
+    bool     dcache_write_through;
+    bool     l2cache_no_write_allocate; // and of the L2
+    bool     l2cache_write_through;
+    uint64_t l2cache_prefetch; // and for the L2
+    uint64_t l2cache_prefetch_degree;
+    uint64_t l2cache_prefetch_distance;
+
+    Hier_Config* hier;         // -hier file, NULL: the built-in hierarchy of the mode (see hier.h)
+
+    uint64_t swp_core0_ways;
+    uint64_t* swp_quotas;      // per-core SWP quotas, overrides swp_core0_ways
+    uint64_t ucp_epoch_cycles; // UCP repartitions the ways this often, 0: keeps the even split
+
+    bool     dram_page_policy;
+
+    bool     tlb;              // model the TLBs and page walks (see memsys.h), else translation is free
+    uint64_t itlb_entries;     // per core
+    uint64_t itlb_assoc;
+    uint64_t dtlb_entries;     // per core
+    uint64_t dtlb_assoc;
+    uint64_t l2tlb_entries;    // shared by the cores
+    uint64_t l2tlb_assoc;
+    uint64_t l2tlb_latency;    // extra cycles of an L1 TLB miss that hits in the L2 TLB
+
+    uint64_t page_size;        // bytes, 4KB or 2MB
+    Addr*    huge_page_start;  // virtual address ranges mapped with 2MB pages whatever page_size is
+    Addr*    huge_page_end;
+    uint64_t num_huge_regions;
+    bool     layout_stats;     // report DRAM row locality and cache set conflicts (set with the above)
+
+    bool     core_ooo;         // out-of-order core timing (see core.h), else blocking in-order
+    uint64_t rob_size;         // out-of-order: instruction window entries
+    uint64_t issue_width;      // instructions it dispatches per cycle
+    uint64_t retire_width;     // and retires in order per cycle
+    uint64_t store_buffer_entries; // stores drain to the L1 behind the core, 0: stores are free
+
+    uint64_t num_cores;        // one core per trace
+    char**   trace_filename;
+
+    uint64_t trace_prefetch_entries; // 0: decode on the simulation thread
+    uint64_t trace_skip_inst;
+    uint64_t trace_max_inst;   // 0: run to the end of the trace
+
+    bool     event_skip;       // jump over cycles where every core is snoozing
+    bool     cache_specialize; // compiled-in cache code for common geometries (cache_specialize())
+
+    bool     parallel;         // one host thread per core (modes D/E, see parsim.h)
+    uint64_t quantum;          // parallel: 0 exact lockstep, else bounded slack in cycles
+
+    uint64_t sdprof_depth;     // 0: off, else LRU stack depth of the miss-ratio curves
+    uint64_t sdprof_min_size;
+    uint64_t sdprof_max_size;
+    char*    sdprof_csv;       // every (sets, assoc) point of every cache, NULL: none
+
+    uint64_t interval_cycles;  // sample interval stats every N cycles, 0: off
+    uint64_t interval_inst;    // or every N instructions over all cores, 0: off
+    char*    interval_out;     // CSV, or JSON if the name ends in .json
+};
+
 /**************************************************************************************/
 
 #define __TYPES_H__